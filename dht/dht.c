@@ -4,148 +4,633 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include "dht_pio_program.h"
+#include "dht_timing.h"
 #include <dht.h>
 #include <dht.pio.h>
+#include <dht_filter.h>
+#include <dht_history.h>
 #include <hardware/clocks.h>
 #include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
 #include <pico/stdlib.h>
-#include <math.h>
 #include <string.h>
 
-static const uint PIO_SM_CLOCK_FREQUENCY = 1000000; // 1MHz
-static const uint DHT_LONG_PULSE_THRESHOLD_US = 50;
-static const uint DHT_MEASUREMENT_TIMEOUT_US = 6000;
+// without DMA, completion callbacks poll the RX FIFO this often
+static const uint DHT_FIFO_POLL_INTERVAL_US = 250;
+
+#ifndef DHT_DMA_IRQ_INDEX
+#define DHT_DMA_IRQ_INDEX 0 // use DMA_IRQ_0 for completion callbacks
+#endif
 
 //
 // misc
 //
 
-static uint get_start_pulse_duration_us(dht_model_t model) {
-    return (model == DHT21 || model == DHT22) ? 1000 : 18000;
+// Derive the clock divider from the current clk_sys, and recompute loop counts
+// from the frequency actually obtained, so divider rounding doesn't skew timing.
+static void update_timing(dht_t *dht) {
+    uint32_t sys_clock_frequency = clock_get_hz(clk_sys);
+    dht->clkdiv_x256 = dht_get_clkdiv_x256(sys_clock_frequency, dht->pio_clock_frequency);
+    dht->actual_pio_clock_frequency = dht_get_actual_pio_clock_frequency(sys_clock_frequency, dht->clkdiv_x256);
+    dht->start_signal_loops = dht_get_pio_sm_loops(dht->actual_pio_clock_frequency, dht_get_start_pulse_duration_us(dht->model), dht_start_signal_clocks_per_loop);
+    // unused by the pulse capture program
+    uint pulse_clocks_per_loop = dht->compact_program ? dht_compact_pulse_measurement_clocks_per_loop : dht_pulse_measurement_clocks_per_loop;
+    dht->long_pulse_loops = dht_get_pio_sm_loops(dht->actual_pio_clock_frequency, DHT_LONG_PULSE_THRESHOLD_US, pulse_clocks_per_loop);
 }
 
-static uint get_pio_sm_clocks(uint us) {
-    float clocks_per_microsecond = PIO_SM_CLOCK_FREQUENCY / 1000000.0f;
-    return roundf(us * clocks_per_microsecond);
+// PIO programs are shared by all sensors on the same PIO block
+enum {
+    PIO_PROGRAM_BITS,
+    PIO_PROGRAM_PULSES,
+    PIO_PROGRAM_COMPACT,
+};
+
+static dht_pio_program_t pio_programs[] = {
+    { .program = &dht_program },
+    { .program = &dht_pulses_program },
+    { .program = &dht_compact_program },
+};
+// where each program waits for the sensor to pull the line low; the acknowledge
+// that follows may take a few hundred microseconds, and isn't timed separately
+static const uint8_t pio_program_response_offset[] = {
+    dht_offset_loop_until_ready_lo,
+    dht_pulses_offset_loop_until_ready_lo,
+    dht_compact_offset_loop_until_ready_lo,
+};
+
+static const PIO pio_instances[NUM_PIOS] = {
+    pio0,
+    pio1,
+#if NUM_PIOS > 2
+    pio2,
+#endif
+};
+
+static uint get_pio_program(const dht_t *dht) {
+    if (dht->pulses != NULL) {
+        return PIO_PROGRAM_PULSES;
+    }
+    return dht->compact_program ? PIO_PROGRAM_COMPACT : PIO_PROGRAM_BITS;
+}
+
+static bool has_callback(const dht_t *dht) {
+    return dht->callback != NULL || dht->callback_x10 != NULL;
+}
+
+// completion interrupt is taken in callback mode, and to wake up low-power waits
+static bool needs_completion_irq(const dht_t *dht) {
+    return has_callback(dht) || dht->low_power;
+}
+
+static bool has_unclaimed_sm(PIO pio) {
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (!pio_sm_is_claimed(pio, sm)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static PIO find_pio(uint program) {
+    // prefer blocks where the program is already loaded, so it's shared
+    for (uint pio_index = 0; pio_index < NUM_PIOS; pio_index++) {
+        PIO pio = pio_instances[pio_index];
+        if (dht_pio_program_is_loaded(&pio_programs[program], pio) && has_unclaimed_sm(pio)) {
+            return pio;
+        }
+    }
+    for (uint pio_index = 0; pio_index < NUM_PIOS; pio_index++) {
+        PIO pio = pio_instances[pio_index];
+        if (pio_can_add_program(pio, pio_programs[program].program) && has_unclaimed_sm(pio)) {
+            return pio;
+        }
+    }
+    return NULL;
 }
 
 static bool pio_sm_is_enabled(PIO pio, uint sm) {
     return (pio->ctrl & (1 << sm)) != 0;
 }
 
-static void dht_program_init(PIO pio, uint sm, uint offset, dht_model_t model, uint data_pin) {
-    pio_sm_config c = dht_program_get_default_config(offset);
-    uint32_t sys_clock_frequency = clock_get_hz(clk_sys);
-    sm_config_set_clkdiv(&c, sys_clock_frequency / (float)PIO_SM_CLOCK_FREQUENCY);
+static void dht_program_init(PIO pio, uint sm, uint offset, uint data_pin, uint program, uint32_t clkdiv_x256) {
+    pio_sm_config c;
+    switch (program) {
+    case PIO_PROGRAM_PULSES:
+        c = dht_pulses_program_get_default_config(offset);
+        break;
+    case PIO_PROGRAM_COMPACT:
+        c = dht_compact_program_get_default_config(offset);
+        break;
+    default:
+        c = dht_program_get_default_config(offset);
+        break;
+    }
+    sm_config_set_clkdiv_int_frac(&c, clkdiv_x256 >> 8, clkdiv_x256 & 0xFF);
     sm_config_set_set_pins(&c, data_pin, 1);
-    // configuring jmp pin is enough, we don't need any other input pins
+    // waits (and compact bit samples) read the data pin as IN pin 0, the other programs test it with jmp pin
+    sm_config_set_in_pins(&c, data_pin);
     sm_config_set_jmp_pin(&c, data_pin);
-    // bits arrive in MSB order and are shifted to the left; autopush every 8 bits
-    sm_config_set_in_shift(&c, false /* shift_right */, true /* autopush */, 8 /* push_threshold */);
+    if (program == PIO_PROGRAM_PULSES) {
+        // pulse widths are pushed explicitly
+        sm_config_set_in_shift(&c, false /* shift_right */, false /* autopush */, 32 /* push_threshold */);
+    } else {
+        // bits arrive in MSB order and are shifted to the left; autopush every 8 bits
+        sm_config_set_in_shift(&c, false /* shift_right */, true /* autopush */, 8 /* push_threshold */);
+    }
     pio_sm_init(pio, sm, offset, &c);
+}
+
+static void dht_program_restart(PIO pio, uint sm, uint offset, uint32_t start_signal_loops, uint32_t long_pulse_loops, bool join_rx) {
+    // the configuration is kept from dht_program_init(), only reset the execution state
+    // (toggling the join also clears the FIFOs)
+    hw_clear_bits(&pio->sm[sm].shiftctrl, PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS);
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+    pio_sm_exec(pio, sm, pio_encode_jmp(offset));
 
     // push timing values
-    pio_sm_put_blocking(pio, sm, get_pio_sm_clocks(get_start_pulse_duration_us(model) / dht_start_signal_clocks_per_loop));
-    pio_sm_put_blocking(pio, sm, get_pio_sm_clocks(DHT_LONG_PULSE_THRESHOLD_US / dht_pulse_measurement_clocks_per_loop));
+    pio_sm_put(pio, sm, start_signal_loops);
+    pio_sm_put(pio, sm, long_pulse_loops);
     // drive the data pin low to wake sensor
     pio_sm_exec(pio, sm, pio_encode_set(pio_pindirs, 1));
     // pull the start-signal duration
     pio_sm_exec(pio, sm, pio_encode_pull(/* if_empty */ false, /* block */ true));
     // store it in Y register for the loop
     pio_sm_exec(pio, sm, pio_encode_mov(pio_y, pio_osr));
-    // pull the long pulse threshold
+    // pull the long pulse threshold (unused when capturing pulses)
     pio_sm_exec(pio, sm, pio_encode_pull(/* if_empty */ false, /* block */ true));
-    // start executing the PIO program
-    pio_sm_set_enabled(pio, sm, true);
+    if (join_rx) {
+        // TX FIFO no longer needed, the 8-deep RX FIFO holds the whole frame
+        hw_set_bits(&pio->sm[sm].shiftctrl, PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS);
+    }
 }
 
-static void configure_dma_channel(uint chan, PIO pio, uint sm, uint8_t *write_addr) {
-    dma_channel_config c = dma_channel_get_default_config(chan);
-    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false /* is_tx */));
-    channel_config_set_irq_quiet(&c, true);
-    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+static void configure_dma_channel(const dht_t *dht, bool irq_quiet) {
+    dma_channel_config c = dma_channel_get_default_config(dht->dma_chan);
+    channel_config_set_dreq(&c, pio_get_dreq(dht->pio, dht->sm, false /* is_tx */));
+    channel_config_set_irq_quiet(&c, irq_quiet);
+    channel_config_set_transfer_data_size(&c, (dht->pulses == NULL) ? DMA_SIZE_8 : DMA_SIZE_32);
     channel_config_set_read_increment(&c, false);
     channel_config_set_write_increment(&c, true);
-    dma_channel_configure(chan, &c, write_addr, &pio->rxf[sm], 5, true /* trigger */);
+    dma_channel_configure(dht->dma_chan, &c, NULL, &dht->pio->rxf[dht->sm], 0, false /* trigger */);
 }
 
-static float decode_temperature(dht_model_t model, uint8_t b0, uint8_t b1) {
-    float temperature;
-    switch (model) {
-    case DHT11:
-        if (b1 & 0x80) {
-            // below-zero temperature not supported
-            temperature = 0.0f;
-        } else {
-            temperature = b0 + 0.1f * (b1 & 0x7F);
+static void trigger_dma_channel(dht_t *dht) {
+    if (dht->pulses == NULL) {
+        dma_channel_transfer_to_buffer_now(dht->dma_chan, dht->frame, sizeof(dht->data));
+    } else {
+        dma_channel_transfer_to_buffer_now(dht->dma_chan, dht->pulses, DHT_PULSE_COUNT);
+    }
+}
+
+static uint get_received_count(const dht_t *dht) {
+    if (!dht->use_dma) {
+        return pio_sm_get_rx_fifo_level(dht->pio, dht->sm);
+    }
+    uint32_t transfer_count = (dht->pulses == NULL) ? sizeof(dht->data) : DHT_PULSE_COUNT;
+    return transfer_count - dma_channel_hw_addr(dht->dma_chan)->transfer_count;
+}
+
+static bool is_transfer_done(const dht_t *dht) {
+    if (!dht->use_dma) {
+        return pio_sm_get_rx_fifo_level(dht->pio, dht->sm) >= sizeof(dht->data);
+    }
+    return !dma_channel_is_busy(dht->dma_chan);
+}
+
+static uint32_t get_pulse_width_us(const dht_t *dht, uint32_t loops) {
+    uint64_t clocks = (uint64_t)loops * dht_pulses_pulse_measurement_clocks_per_loop;
+    return (clocks * 1000000 + dht->actual_pio_clock_frequency / 2) / dht->actual_pio_clock_frequency;
+}
+
+static dht_result_t to_float(dht_result_t result, int16_t humidity_x10, int16_t temperature_c_x10, float *humidity, float *temperature_c) {
+    if (result == DHT_RESULT_OK) {
+        if (humidity != NULL) {
+            *humidity = 0.1f * humidity_x10;
         }
-        break;
-    case DHT12:
-        temperature = b0 + 0.1f * (b1 & 0x7F);
-        if (b1 & 0x80) {
-            temperature = -temperature;
+        if (temperature_c != NULL) {
+            *temperature_c = 0.1f * temperature_c_x10;
         }
-        break;
-    case DHT21:
-    case DHT22:
-        temperature = 0.1f * (((b0 & 0x7F) << 8) + b1);
-        if (b0 & 0x80) {
-            temperature = -temperature;
+    }
+    return result;
+}
+
+static uint32_t get_measurement_timeout_us(const dht_t *dht) {
+    return dht_get_start_pulse_duration_us(dht->model) + DHT_MEASUREMENT_TIMEOUT_US;
+}
+
+static bool is_waiting_for_response(const dht_t *dht) {
+    uint pc = pio_sm_get_pc(dht->pio, dht->sm);
+    return pc - dht->pio_program_offset <= pio_program_response_offset[get_pio_program(dht)];
+}
+
+// Returns DHT_RESULT_OK once all data has arrived, DHT_RESULT_IN_PROGRESS while
+// the measurement is on track, or the failure detected so far. The sensor is
+// expected to respond shortly after the start signal and then keep sending
+// bits at a steady pace, so a dead sensor or broken frame is detected early.
+static dht_result_t check_measurement(const dht_t *dht, uint32_t *next_check_us) {
+    if (is_transfer_done(dht)) {
+        return DHT_RESULT_OK;
+    }
+    uint32_t elapsed_us = time_us_32() - dht->start_time;
+    uint32_t timeout_us = get_measurement_timeout_us(dht);
+    if (elapsed_us >= timeout_us) {
+        return DHT_RESULT_TIMEOUT;
+    }
+    uint32_t deadline_us = dht_get_start_pulse_duration_us(dht->model) + DHT_RESPONSE_TIMEOUT_US;
+    if (elapsed_us >= deadline_us) {
+        if (is_waiting_for_response(dht)) {
+            return DHT_RESULT_NO_RESPONSE;
+        }
+        // each byte (or pulse width, when capturing pulses) advances the deadline
+        uint32_t bits_per_transfer = (dht->pulses == NULL) ? 8 : 1;
+        deadline_us += DHT_ACKNOWLEDGE_TIMEOUT_US + (get_received_count(dht) + 1) * bits_per_transfer * DHT_BIT_TIMEOUT_US;
+        if (elapsed_us >= deadline_us) {
+            return DHT_RESULT_STALLED;
+        }
+    }
+    if (next_check_us != NULL) {
+        *next_check_us = MIN(deadline_us, timeout_us) - elapsed_us;
+        if (!dht->use_dma && elapsed_us >= dht_get_start_pulse_duration_us(dht->model)) {
+            // no completion interrupt, poll for the last byte
+            *next_check_us = MIN(*next_check_us, DHT_FIFO_POLL_INTERVAL_US);
         }
-        break;
-    default:
-        assert(false); // invalid model
     }
-    return temperature;
+    return DHT_RESULT_IN_PROGRESS;
 }
 
-static float decode_humidity(dht_model_t model, uint8_t b0, uint8_t b1) {
-    float humidity;
-    switch (model) {
-    case DHT11:
-    case DHT12:
-        humidity = b0 + 0.1f * b1;
+static void update_cache(dht_t *dht, int16_t humidity_x10, int16_t temperature_c_x10) {
+    // sequence counter is odd while an update is in progress
+    dht->cache_seq++;
+    __dmb();
+    dht->cache_humidity_x10 = humidity_x10;
+    dht->cache_temperature_c_x10 = temperature_c_x10;
+    dht->cache_time_us = time_us_64();
+    __dmb();
+    dht->cache_seq++;
+}
+
+static void read_cache(const dht_t *dht, int16_t *humidity_x10, int16_t *temperature_c_x10, uint64_t *time_us) {
+    uint32_t seq;
+    do {
+        seq = dht->cache_seq;
+        __dmb();
+        *humidity_x10 = dht->cache_humidity_x10;
+        *temperature_c_x10 = dht->cache_temperature_c_x10;
+        *time_us = dht->cache_time_us;
+        __dmb();
+    } while ((seq & 1) != 0 || seq != dht->cache_seq);
+}
+
+#if DHT_STATS_ENABLED
+static void record_stats(dht_t *dht, dht_result_t result, uint32_t latency_us) {
+    dht_stats_t *stats = &dht->stats;
+    switch (result) {
+    case DHT_RESULT_OK:
+        stats->ok_count++;
+        if (latency_us < stats->latency_min_us || stats->ok_count == 1) {
+            stats->latency_min_us = latency_us;
+        }
+        if (latency_us > stats->latency_max_us) {
+            stats->latency_max_us = latency_us;
+        }
+        uint bucket = latency_us / DHT_STATS_LATENCY_BUCKET_US;
+        stats->latency_histogram[MIN(bucket, DHT_STATS_LATENCY_BUCKETS - 1)]++;
+        break;
+    case DHT_RESULT_TIMEOUT:
+        stats->timeout_count++;
+        break;
+    case DHT_RESULT_BAD_CHECKSUM:
+        stats->bad_checksum_count++;
         break;
-    case DHT21:
-    case DHT22:
-        humidity = 0.1f * ((b0 << 8) + b1);
+    case DHT_RESULT_NO_RESPONSE:
+        stats->no_response_count++;
+        break;
+    case DHT_RESULT_STALLED:
+        stats->stalled_count++;
         break;
     default:
-        assert(false); // invalid model
+        break;
+    }
+    dht->last_failed = (result != DHT_RESULT_OK);
+}
+#endif
+
+static dht_result_t read_raw_frame(dht_t *dht, dht_result_t status) {
+    pio_sm_set_enabled(dht->pio, dht->sm, false);
+    // make sure pin is left in hi-z mode
+    pio_sm_exec(dht->pio, dht->sm, pio_encode_set(pio_pindirs, 0));
+
+    if (!dht->use_dma) {
+        if (!is_transfer_done(dht)) {
+            // leftover bytes are cleared on restart
+            return (status == DHT_RESULT_OK) ? DHT_RESULT_TIMEOUT : status;
+        }
+        for (uint i = 0; i < sizeof(dht->data); i++) {
+            dht->frame[i] = pio_sm_get(dht->pio, dht->sm);
+        }
+    } else if (dma_channel_is_busy(dht->dma_chan)) {
+        if (needs_completion_irq(dht)) {
+            // aborting may raise a spurious completion interrupt (RP2040-E13)
+            dma_irqn_set_channel_enabled(DHT_DMA_IRQ_INDEX, dht->dma_chan, false);
+            dma_channel_abort(dht->dma_chan);
+            dma_irqn_acknowledge_channel(DHT_DMA_IRQ_INDEX, dht->dma_chan);
+            dma_irqn_set_channel_enabled(DHT_DMA_IRQ_INDEX, dht->dma_chan, true);
+        } else {
+            dma_channel_abort(dht->dma_chan);
+        }
+        // the transfer may have completed meanwhile, but data is incomplete otherwise
+        return (status == DHT_RESULT_OK) ? DHT_RESULT_TIMEOUT : status;
+    }
+    if (dht->pulses != NULL) {
+        for (uint i = 0; i < DHT_PULSE_COUNT; i++) {
+            dht->pulses[i] = get_pulse_width_us(dht, dht->pulses[i]);
+        }
+        dht_decode_pulses(dht->pulses, dht->frame);
+    }
+    const uint8_t *frame = dht->frame;
+    uint8_t payload_sum;
+    if (dht->hw_checksum) {
+        // the sniffer has summed all 5 bytes, including the checksum itself
+        payload_sum = dma_sniffer_get_data_accumulator() - frame[4];
+    } else {
+        payload_sum = frame[0] + frame[1] + frame[2] + frame[3];
+    }
+    return (payload_sum == frame[4]) ? DHT_RESULT_OK : DHT_RESULT_BAD_CHECKSUM;
+}
+
+static dht_result_t read_frame(dht_t *dht, dht_result_t status, int16_t *humidity_x10, int16_t *temperature_c_x10) {
+    dht_result_t result = read_raw_frame(dht, status);
+    if (result == DHT_RESULT_OK) {
+        *humidity_x10 = dht_decode_humidity_x10(dht->model, dht->frame[0], dht->frame[1]);
+        *temperature_c_x10 = dht_decode_temperature_x10(dht->model, dht->frame[2], dht->frame[3]);
+    }
+    return result;
+}
+
+static dht_result_t finish_raw_measurement(dht_t *dht, dht_result_t status) {
+#if DHT_STATS_ENABLED
+    uint32_t latency_us = time_us_32() - dht->start_time;
+#endif
+    dht_result_t result = read_raw_frame(dht, status);
+#if DHT_STATS_ENABLED
+    record_stats(dht, result, latency_us);
+#endif
+    return result;
+}
+
+static dht_result_t finish_measurement(dht_t *dht, dht_result_t status, int16_t *humidity_x10, int16_t *temperature_c_x10) {
+#if DHT_STATS_ENABLED
+    uint32_t latency_us = time_us_32() - dht->start_time;
+#endif
+    dht_result_t result = read_frame(dht, status, humidity_x10, temperature_c_x10);
+    if (result == DHT_RESULT_OK) {
+        // the filter only affects cached readings, callers get the measured values
+        int16_t h = *humidity_x10;
+        int16_t t = *temperature_c_x10;
+        if (dht->filter == NULL || dht_filter_update(dht->filter, &h, &t)) {
+            update_cache(dht, h, t);
+        }
+    }
+#if DHT_STATS_ENABLED
+    record_stats(dht, result, latency_us);
+#endif
+    if (dht->history != NULL) {
+        dht_record_t record = {
+            .time_us = time_us_64(),
+            .temperature_c_x10 = (result == DHT_RESULT_OK) ? *temperature_c_x10 : 0,
+            .humidity_x10 = (result == DHT_RESULT_OK) ? *humidity_x10 : 0,
+            .result = result,
+        };
+        dht_history_push(dht->history, &record);
+    }
+    return result;
+}
+
+//
+// completion callbacks
+//
+
+static dht_t *dma_channel_sensors[NUM_DMA_CHANNELS];
+static dht_t *dma_sniffer_owner;
+static uint dma_irq_handler_users;
+
+static void complete_measurement_from_irq(dht_t *dht, dht_result_t status) {
+    // the DMA and timer interrupts may race to complete the measurement
+    uint32_t irq_status = save_and_disable_interrupts();
+    bool pending = dht->completion_pending;
+    dht->completion_pending = false;
+    restore_interrupts(irq_status);
+    if (!pending) {
+        return;
+    }
+    int16_t humidity_x10 = 0;
+    int16_t temperature_c_x10 = 0;
+    dht_result_t result = finish_measurement(dht, status, &humidity_x10, &temperature_c_x10);
+    if (dht->callback_x10 != NULL) {
+        dht->callback_x10(dht, result, humidity_x10, temperature_c_x10, dht->callback_user_data);
+        return;
+    }
+    float humidity = 0.0f;
+    float temperature_c = 0.0f;
+    to_float(result, humidity_x10, temperature_c_x10, &humidity, &temperature_c);
+    dht->callback(dht, result, humidity, temperature_c, dht->callback_user_data);
+}
+
+static void dma_irq_handler(void) {
+    for (uint chan = 0; chan < NUM_DMA_CHANNELS; chan++) {
+        dht_t *dht = dma_channel_sensors[chan];
+        if (dht != NULL && dma_irqn_get_channel_status(DHT_DMA_IRQ_INDEX, chan)) {
+            dma_irqn_acknowledge_channel(DHT_DMA_IRQ_INDEX, chan);
+            if (!has_callback(dht)) {
+                continue; // low-power wait, taking the interrupt is enough to wake the core
+            }
+            if (dht->timeout_alarm > 0) {
+                cancel_alarm(dht->timeout_alarm);
+                dht->timeout_alarm = 0;
+            }
+            complete_measurement_from_irq(dht, DHT_RESULT_OK);
+        }
+    }
+}
+
+static int64_t timeout_alarm_callback(alarm_id_t id, void *user_data) {
+    dht_t *dht = user_data;
+    uint32_t next_check_us;
+    dht_result_t status = check_measurement(dht, &next_check_us);
+    if (status == DHT_RESULT_IN_PROGRESS && dht->completion_pending) {
+        return next_check_us; // check again at the next deadline
+    }
+    dht->timeout_alarm = 0;
+    complete_measurement_from_irq(dht, status);
+    return 0; // don't reschedule
+}
+
+static void enable_completion_irq(dht_t *dht) {
+    if (!dht->use_dma) {
+        return; // completion is detected by the timeout alarm
+    }
+    assert(dma_channel_sensors[dht->dma_chan] == NULL);
+    dma_channel_sensors[dht->dma_chan] = dht;
+    if (dma_irq_handler_users++ == 0) {
+        irq_add_shared_handler(DMA_IRQ_0 + DHT_DMA_IRQ_INDEX, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0 + DHT_DMA_IRQ_INDEX, true);
+    }
+    dma_irqn_acknowledge_channel(DHT_DMA_IRQ_INDEX, dht->dma_chan);
+    dma_irqn_set_channel_enabled(DHT_DMA_IRQ_INDEX, dht->dma_chan, true);
+}
+
+static void disable_completion_irq(dht_t *dht) {
+    if (!dht->use_dma) {
+        return;
+    }
+    assert(dma_channel_sensors[dht->dma_chan] == dht);
+    dma_irqn_set_channel_enabled(DHT_DMA_IRQ_INDEX, dht->dma_chan, false);
+    dma_irqn_acknowledge_channel(DHT_DMA_IRQ_INDEX, dht->dma_chan);
+    dma_channel_sensors[dht->dma_chan] = NULL;
+    if (--dma_irq_handler_users == 0) {
+        // other users may share the IRQ line, so leave it enabled
+        irq_remove_handler(DMA_IRQ_0 + DHT_DMA_IRQ_INDEX, dma_irq_handler);
+    }
+}
+
+static void set_completion_irq_enabled(dht_t *dht, bool enabled) {
+    if (enabled) {
+        if (dht->use_dma) {
+            configure_dma_channel(dht, false /* irq_quiet */);
+        }
+        enable_completion_irq(dht);
+    } else {
+        disable_completion_irq(dht);
+        if (dht->use_dma) {
+            configure_dma_channel(dht, true /* irq_quiet */);
+        }
+    }
+}
+
+static void wait_for_measurement(dht_t *dht) {
+    if (!dht->low_power) {
+        return; // caller spins
+    }
+    uint32_t next_check_us;
+    while (check_measurement(dht, &next_check_us) == DHT_RESULT_IN_PROGRESS) {
+        // woken by the completion interrupt, or by the SDK alarm at the next check
+        best_effort_wfe_or_timeout(make_timeout_time_us(next_check_us));
+    }
+}
+
+static void prepare_measurement(dht_t *dht) {
+    memset(dht->frame, 0, sizeof(dht->data));
+    dht_program_restart(dht->pio, dht->sm, dht->pio_program_offset, dht->start_signal_loops, dht->long_pulse_loops, !dht->use_dma);
+    if (!dht->use_dma) {
+        return; // bytes are left in the RX FIFO
+    }
+    if (dht->hw_checksum) {
+        dma_sniffer_enable(dht->dma_chan, DMA_SNIFF_CTRL_CALC_VALUE_SUM, true /* force_channel_enable */);
+        dma_sniffer_set_data_accumulator(0);
+    }
+    // the channel is configured in advance, just re-trigger it
+    trigger_dma_channel(dht);
+}
+
+static void begin_measurement(dht_t *dht) {
+    dht->start_time = time_us_32();
+#if DHT_STATS_ENABLED
+    if (dht->last_failed) {
+        dht->stats.retry_count++;
+    }
+#endif
+
+    if (has_callback(dht)) {
+        dht->completion_pending = true;
+        uint32_t next_check_us = dht_get_start_pulse_duration_us(dht->model) + DHT_RESPONSE_TIMEOUT_US;
+        dht->timeout_alarm = add_alarm_in_us(next_check_us, timeout_alarm_callback, dht, true /* fire_if_past */);
+        hard_assert(dht->timeout_alarm > 0); // no alarm slots left
     }
-    return humidity;
 }
 
 //
 // public interface
 //
 
+dht_config_t dht_get_default_config(dht_model_t model, PIO pio, uint8_t data_pin) {
+    dht_config_t config = {
+        .model = model,
+        .pio = pio,
+        .data_pin = data_pin,
+        .pull_up = true,
+        .use_dma = true,
+        .pio_clock_frequency = DHT_PIO_SM_CLOCK_FREQUENCY,
+    };
+    return config;
+}
+
 void dht_init(dht_t *dht, dht_model_t model, PIO pio, uint8_t data_pin, bool pull_up) {
-    assert(pio == pio0 || pio == pio1);
+    dht_config_t config = dht_get_default_config(model, pio, data_pin);
+    config.pull_up = pull_up;
+    dht_init_with_config(dht, &config);
+}
 
+void dht_init_with_config(dht_t *dht, const dht_config_t *config) {
     memset(dht, 0, sizeof(dht_t));
-    dht->model = model;
-    dht->pio = pio;
-    dht->pio_program_offset = pio_add_program(pio, &dht_program);
-    dht->sm = pio_claim_unused_sm(pio, true /* required */);
-    dht->dma_chan = dma_claim_unused_channel(true /* required */);
-    dht->data_pin = data_pin;
+    dht->model = config->model;
+    dht->frame = dht->data;
+    dht->compact_program = config->compact_program;
+    dht->pio = (config->pio != NULL) ? config->pio : find_pio(get_pio_program(dht));
+    hard_assert(dht->pio != NULL); // no PIO block with a free state machine and program space
+    assert(pio_get_index(dht->pio) < NUM_PIOS);
+    dht->pio_program_offset = dht_pio_program_acquire(&pio_programs[get_pio_program(dht)], dht->pio);
+    dht->sm = pio_claim_unused_sm(dht->pio, true /* required */);
+    dht->use_dma = config->use_dma;
+    dht->low_power = config->low_power;
+    if (dht->use_dma) {
+        dht->dma_chan = dma_claim_unused_channel(true /* required */);
+    }
+    dht->data_pin = config->data_pin;
+    dht->pio_clock_frequency = (config->pio_clock_frequency != 0) ? config->pio_clock_frequency : DHT_PIO_SM_CLOCK_FREQUENCY;
+    update_timing(dht);
+    // allow the first measurement to start right away
+    dht->start_time = time_us_32() - dht_get_min_interval_us(dht->model);
+
+    pio_gpio_init(dht->pio, dht->data_pin);
+    gpio_set_pulls(dht->data_pin, config->pull_up, false /* down */);
 
-    pio_gpio_init(pio, data_pin);
-    gpio_set_pulls(data_pin, pull_up, false /* down */);
+    // state machine and DMA channel are configured once, and only restarted per measurement
+    dht_program_init(dht->pio, dht->sm, dht->pio_program_offset, dht->data_pin, get_pio_program(dht), dht->clkdiv_x256);
+    if (dht->use_dma) {
+        configure_dma_channel(dht, !dht->low_power /* irq_quiet */);
+    }
+    if (dht->low_power) {
+        enable_completion_irq(dht);
+    }
 }
 
 void dht_deinit(dht_t *dht) {
     assert(dht->pio != NULL); // not initialized
 
-    dma_channel_abort(dht->dma_chan);
-    dma_channel_unclaim(dht->dma_chan);
+    if (dht->hw_checksum) {
+        dht_enable_hw_checksum(dht, false);
+    }
+    if (has_callback(dht) && dht->timeout_alarm > 0) {
+        cancel_alarm(dht->timeout_alarm);
+    }
+    if (needs_completion_irq(dht)) {
+        disable_completion_irq(dht);
+    }
+    dht->callback = NULL;
+    dht->callback_x10 = NULL;
+    if (dht->use_dma) {
+        dma_channel_abort(dht->dma_chan);
+        dma_channel_unclaim(dht->dma_chan);
+    }
 
     pio_sm_set_enabled(dht->pio, dht->sm, false);
     // make sure pin is left in hi-z mode; original pin function & pulls are not restored
     pio_sm_set_consecutive_pindirs(dht->pio, dht->sm, dht->data_pin, 1, false /* is_out */);
     pio_sm_unclaim(dht->pio, dht->sm);
-    pio_remove_program(dht->pio, &dht_program, dht->pio_program_offset);
+    dht_pio_program_release(&pio_programs[get_pio_program(dht)], dht->pio);
 
     dht->pio = NULL;
 }
@@ -154,37 +639,348 @@ void dht_start_measurement(dht_t *dht) {
     assert(dht->pio != NULL); // not initialized
     assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // another measurement in progress
 
-    memset(dht->data, 0, sizeof(dht->data));
-    configure_dma_channel(dht->dma_chan, dht->pio, dht->sm, dht->data);
-    dht_program_init(dht->pio, dht->sm, dht->pio_program_offset, dht->model, dht->data_pin);
-    dht->start_time = time_us_32();
+    prepare_measurement(dht);
+    // start executing the PIO program
+    pio_sm_set_enabled(dht->pio, dht->sm, true);
+    begin_measurement(dht);
 }
 
-dht_result_t dht_finish_measurement_blocking(dht_t *dht, float *humidity, float *temperature_c) {
+void dht_cancel_measurement(dht_t *dht) {
+    assert(dht->pio != NULL); // not initialized
+
+    if (has_callback(dht)) {
+        // take the completion from the DMA and timer interrupts, which may be racing for it
+        uint32_t irq_status = save_and_disable_interrupts();
+        bool pending = dht->completion_pending;
+        dht->completion_pending = false;
+        restore_interrupts(irq_status);
+        if (!pending) {
+            return; // not started, or already completing
+        }
+        if (dht->timeout_alarm > 0) {
+            cancel_alarm(dht->timeout_alarm);
+            dht->timeout_alarm = 0;
+        }
+    } else if (!pio_sm_is_enabled(dht->pio, dht->sm)) {
+        return;
+    }
+    // stops the state machine, leaves the pin in hi-z, and aborts DMA; the frame is dropped
+    read_raw_frame(dht, DHT_RESULT_TIMEOUT);
+}
+
+static void set_callbacks(dht_t *dht, dht_callback_t callback, dht_callback_x10_t callback_x10, void *user_data) {
+    assert(dht->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // measurement in progress
+
+    bool had_irq = needs_completion_irq(dht);
+    dht->callback = callback;
+    dht->callback_x10 = callback_x10;
+    dht->callback_user_data = user_data;
+    if (needs_completion_irq(dht) != had_irq) {
+        set_completion_irq_enabled(dht, !had_irq);
+    }
+}
+
+void dht_set_callback(dht_t *dht, dht_callback_t callback, void *user_data) {
+    set_callbacks(dht, callback, NULL, user_data);
+}
+
+void dht_set_callback_x10(dht_t *dht, dht_callback_x10_t callback, void *user_data) {
+    set_callbacks(dht, NULL, callback, user_data);
+}
+
+void dht_sync_clock(dht_t *dht) {
+    assert(dht->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // measurement in progress
+
+    // loop counts are pushed on every start, so the next measurement picks them up
+    update_timing(dht);
+    pio_sm_set_clkdiv_int_frac(dht->pio, dht->sm, dht->clkdiv_x256 >> 8, dht->clkdiv_x256 & 0xFF);
+}
+
+dht_result_t dht_try_finish_measurement_x10(dht_t *dht, int16_t *humidity_x10, int16_t *temperature_c_x10) {
     assert(dht->pio != NULL); // not initialized
     assert(pio_sm_is_enabled(dht->pio, dht->sm)); // no measurement in progress
+    assert(!has_callback(dht)); // result is delivered to callback
+
+    dht_result_t status = check_measurement(dht, NULL);
+    if (status == DHT_RESULT_IN_PROGRESS) {
+        return DHT_RESULT_IN_PROGRESS;
+    }
+    int16_t h, t;
+    dht_result_t result = finish_measurement(dht, status, &h, &t);
+    if (result == DHT_RESULT_OK) {
+        if (humidity_x10 != NULL) {
+            *humidity_x10 = h;
+        }
+        if (temperature_c_x10 != NULL) {
+            *temperature_c_x10 = t;
+        }
+    }
+    return result;
+}
 
-    uint32_t timeout = get_start_pulse_duration_us(dht->model) + DHT_MEASUREMENT_TIMEOUT_US;
-    while (dma_channel_is_busy(dht->dma_chan) && time_us_32() - dht->start_time < timeout) {
+dht_result_t dht_try_finish_measurement_raw(dht_t *dht, uint8_t frame[5]) {
+    assert(dht->pio != NULL); // not initialized
+    assert(pio_sm_is_enabled(dht->pio, dht->sm)); // no measurement in progress
+    assert(!has_callback(dht)); // result is delivered to callback
+
+    dht_result_t status = check_measurement(dht, NULL);
+    if (status == DHT_RESULT_IN_PROGRESS) {
+        return DHT_RESULT_IN_PROGRESS;
+    }
+    dht_result_t result = finish_raw_measurement(dht, status);
+    if (result == DHT_RESULT_OK && frame != dht->frame) {
+        memcpy(frame, dht->frame, sizeof(dht->data));
+    }
+    return result;
+}
+
+dht_result_t dht_try_finish_measurement(dht_t *dht, float *humidity, float *temperature_c) {
+    int16_t h, t;
+    dht_result_t result = dht_try_finish_measurement_x10(dht, &h, &t);
+    return to_float(result, h, t, humidity, temperature_c);
+}
+
+dht_result_t dht_finish_measurement_blocking_x10(dht_t *dht, int16_t *humidity_x10, int16_t *temperature_c_x10) {
+    assert(dht->pio != NULL); // not initialized
+    assert(pio_sm_is_enabled(dht->pio, dht->sm)); // no measurement in progress
+    assert(!has_callback(dht)); // result is delivered to callback
+
+    wait_for_measurement(dht);
+    dht_result_t result;
+    while ((result = dht_try_finish_measurement_x10(dht, humidity_x10, temperature_c_x10)) == DHT_RESULT_IN_PROGRESS) {
         tight_loop_contents();
     }
-    pio_sm_set_enabled(dht->pio, dht->sm, false);
-    // make sure pin is left in hi-z mode
-    pio_sm_exec(dht->pio, dht->sm, pio_encode_set(pio_pindirs, 0));
+    return result;
+}
 
-    if (dma_channel_is_busy(dht->dma_chan)) {
-        dma_channel_abort(dht->dma_chan);
-        return DHT_RESULT_TIMEOUT;
+dht_result_t dht_finish_measurement_blocking(dht_t *dht, float *humidity, float *temperature_c) {
+    int16_t h, t;
+    dht_result_t result = dht_finish_measurement_blocking_x10(dht, &h, &t);
+    return to_float(result, h, t, humidity, temperature_c);
+}
+
+dht_result_t dht_get_cached_x10(dht_t *dht, uint64_t max_age_us, int16_t *humidity_x10, int16_t *temperature_c_x10) {
+    assert(dht->pio != NULL); // not initialized
+
+    int16_t h, t;
+    uint64_t time_us;
+    read_cache(dht, &h, &t, &time_us);
+    if (time_us != 0 && time_us_64() - time_us <= max_age_us) {
+        if (humidity_x10 != NULL) {
+            *humidity_x10 = h;
+        }
+        if (temperature_c_x10 != NULL) {
+            *temperature_c_x10 = t;
+        }
+        return DHT_RESULT_OK;
+    }
+    if (has_callback(dht)) {
+        // measurements are started by the callback owner (e.g. dht_scheduler_t),
+        // which also updates the cache on completion
+        return DHT_RESULT_IN_PROGRESS;
+    }
+    if (pio_sm_is_enabled(dht->pio, dht->sm)) {
+        return dht_try_finish_measurement_x10(dht, humidity_x10, temperature_c_x10);
+    }
+    if (time_us_32() - dht->start_time >= dht_get_min_interval_us(dht->model)) {
+        dht_start_measurement(dht);
+    }
+    return DHT_RESULT_IN_PROGRESS;
+}
+
+dht_result_t dht_get_cached(dht_t *dht, uint64_t max_age_us, float *humidity, float *temperature_c) {
+    int16_t h, t;
+    dht_result_t result = dht_get_cached_x10(dht, max_age_us, &h, &t);
+    return to_float(result, h, t, humidity, temperature_c);
+}
+
+void dht_set_history(dht_t *dht, dht_history_t *history) {
+    assert(dht->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // measurement in progress
+
+    dht->history = history;
+}
+
+void dht_set_filter(dht_t *dht, dht_filter_t *filter) {
+    assert(dht->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // measurement in progress
+
+    dht->filter = filter;
+}
+
+// measure once with the timing of the given model
+static dht_result_t probe_model(dht_t *dht, dht_model_t model) {
+    dht->model = model;
+    update_timing(dht);
+    // the longest interval any model needs
+    uint32_t min_interval_us = dht_get_min_interval_us(DHT22);
+    uint32_t elapsed_us = time_us_32() - dht->start_time;
+    if (elapsed_us < min_interval_us) {
+        sleep_us(min_interval_us - elapsed_us);
+    }
+    dht_start_measurement(dht);
+    wait_for_measurement(dht);
+    dht_result_t status;
+    while ((status = check_measurement(dht, NULL)) == DHT_RESULT_IN_PROGRESS) {
+        tight_loop_contents();
+    }
+    return finish_raw_measurement(dht, status);
+}
+
+dht_result_t dht_detect_model(dht_t *dht, dht_model_t *model) {
+    assert(dht->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // measurement in progress
+    assert(!has_callback(dht)); // probes are blocking
+    assert(dht->pulses == NULL); // not available when capturing pulses
+
+    dht_model_t original_model = dht->model;
+    dht_model_t detected = DHT22;
+    // DHT21/DHT22 answer the short start signal, DHT11/DHT12 need the long one
+    dht_result_t result = probe_model(dht, DHT22);
+    if (result != DHT_RESULT_OK || !dht_frame_is_plausible(DHT22, dht->frame)) {
+        result = probe_model(dht, DHT11);
+        if (result == DHT_RESULT_OK) {
+            if (dht_frame_is_plausible(DHT11, dht->frame)) {
+                detected = dht_resolve_dht1x_model(original_model);
+            } else {
+                result = DHT_RESULT_BAD_CHECKSUM; // valid frame, but not from a known model
+            }
+        }
     }
-    uint8_t checksum = dht->data[0] + dht->data[1] + dht->data[2] + dht->data[3];
-    if (dht->data[4] != checksum) {
-        return DHT_RESULT_BAD_CHECKSUM;
+    dht->model = (result == DHT_RESULT_OK) ? detected : original_model;
+    update_timing(dht);
+    if (result == DHT_RESULT_OK && model != NULL) {
+        *model = detected;
     }
-    if (humidity != NULL) {
-        *humidity = decode_humidity(dht->model, dht->data[0], dht->data[1]);
+    return result;
+}
+
+void dht_set_frame_buffer(dht_t *dht, dht_frame_t *frame) {
+    assert(dht->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // measurement in progress
+    assert(frame == NULL || dht->pulses == NULL); // pulse widths don't fit in a frame
+
+    // the DMA write address is set on every trigger, so there's nothing to reconfigure
+    dht->frame = (frame != NULL) ? frame->bytes : dht->data;
+}
+
+void dht_enable_pulse_capture(dht_t *dht, uint32_t *pulse_widths_us) {
+    assert(dht->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // measurement in progress
+    assert(pulse_widths_us == NULL || !dht->hw_checksum); // not available with hardware checksum
+    assert(pulse_widths_us == NULL || dht->use_dma); // 40 widths don't fit in the RX FIFO
+    assert(pulse_widths_us == NULL || dht->frame == dht->data); // not available with a frame buffer
+
+    // release the current program first, so the other one may reuse its space
+    dht_pio_program_release(&pio_programs[get_pio_program(dht)], dht->pio);
+    dht->pulses = pulse_widths_us;
+    dht->pio_program_offset = dht_pio_program_acquire(&pio_programs[get_pio_program(dht)], dht->pio);
+    dht_program_init(dht->pio, dht->sm, dht->pio_program_offset, dht->data_pin, get_pio_program(dht), dht->clkdiv_x256);
+    if (dht->use_dma) {
+        configure_dma_channel(dht, !needs_completion_irq(dht) /* irq_quiet */);
     }
-    if (temperature_c != NULL) {
-        *temperature_c = decode_temperature(dht->model, dht->data[2], dht->data[3]);
+}
+
+bool dht_enable_hw_checksum(dht_t *dht, bool enabled) {
+    assert(dht->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // measurement in progress
+    assert(!enabled || dht->pulses == NULL); // not available when capturing pulses
+
+    if (enabled && !dht->use_dma) {
+        return false; // sniffer only sees DMA transfers
+    }
+    if (enabled) {
+        if (dma_sniffer_owner != NULL && dma_sniffer_owner != dht) {
+            return false; // sniffer used by another sensor
+        }
+        dma_sniffer_owner = dht;
+    } else if (dma_sniffer_owner == dht) {
+        dma_sniffer_disable();
+        dma_sniffer_owner = NULL;
+    }
+    dht->hw_checksum = enabled;
+    return true;
+}
+
+#if DHT_STATS_ENABLED
+void dht_get_stats(const dht_t *dht, dht_stats_t *stats) {
+    // counters may be updated from interrupt context
+    uint32_t status = save_and_disable_interrupts();
+    *stats = dht->stats;
+    restore_interrupts(status);
+}
+
+void dht_reset_stats(dht_t *dht) {
+    uint32_t status = save_and_disable_interrupts();
+    memset(&dht->stats, 0, sizeof(dht->stats));
+    restore_interrupts(status);
+}
+#endif
+
+void dht_group_init(dht_group_t *group, dht_t *sensors, uint count) {
+    assert(count > 0);
+
+    group->sensors = sensors;
+    group->count = count;
+}
+
+void dht_group_start_measurement(dht_group_t *group) {
+    uint32_t sm_masks[NUM_PIOS] = {0};
+    for (uint i = 0; i < group->count; i++) {
+        dht_t *dht = &group->sensors[i];
+        assert(dht->pio != NULL); // not initialized
+        assert(!pio_sm_is_enabled(dht->pio, dht->sm)); // another measurement in progress
+
+        prepare_measurement(dht);
+        uint pio_index = pio_get_index(dht->pio);
+        sm_masks[pio_index] |= 1u << dht->sm;
+    }
+    // start all state machines on the same PIO block together
+    for (uint pio_index = 0; pio_index < NUM_PIOS; pio_index++) {
+        if (sm_masks[pio_index] != 0) {
+            pio_enable_sm_mask_in_sync(pio_instances[pio_index], sm_masks[pio_index]);
+        }
+    }
+    for (uint i = 0; i < group->count; i++) {
+        begin_measurement(&group->sensors[i]);
+    }
+}
+
+void dht_group_finish_measurement_blocking(dht_group_t *group, dht_reading_t *readings) {
+    for (uint i = 0; i < group->count; i++) {
+        dht_t *dht = &group->sensors[i];
+        assert(pio_sm_is_enabled(dht->pio, dht->sm)); // no measurement in progress
+        assert(!has_callback(dht)); // result is delivered to callback
+
+        wait_for_measurement(dht);
+        dht_result_t status;
+        while ((status = check_measurement(dht, NULL)) == DHT_RESULT_IN_PROGRESS) {
+            tight_loop_contents();
+        }
+        int16_t h, t;
+        readings[i].result = to_float(finish_measurement(dht, status, &h, &t), h, t, &readings[i].humidity, &readings[i].temperature_c);
+    }
+}
+
+void dht_group_set_frame_buffers(dht_group_t *group, dht_frame_t *frames) {
+    for (uint i = 0; i < group->count; i++) {
+        dht_set_frame_buffer(&group->sensors[i], (frames != NULL) ? &frames[i] : NULL);
+    }
+}
+
+void dht_group_finish_measurement_raw_blocking(dht_group_t *group, dht_result_t *results) {
+    for (uint i = 0; i < group->count; i++) {
+        dht_t *dht = &group->sensors[i];
+        assert(pio_sm_is_enabled(dht->pio, dht->sm)); // no measurement in progress
+        assert(!has_callback(dht)); // result is delivered to callback
+
+        wait_for_measurement(dht);
+        dht_result_t status;
+        while ((status = check_measurement(dht, NULL)) == DHT_RESULT_IN_PROGRESS) {
+            tight_loop_contents();
+        }
+        results[i] = finish_raw_measurement(dht, status);
     }
-    return DHT_RESULT_OK;
 }
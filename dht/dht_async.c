@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <dht_async.h>
+#include <string.h>
+
+// runs in interrupt context
+static void result_callback(dht_t *dht, dht_result_t result, int16_t humidity_x10, int16_t temperature_c_x10, void *user_data) {
+    dht_async_t *async = user_data;
+    async->result = result;
+    async->humidity_x10 = humidity_x10;
+    async->temperature_c_x10 = temperature_c_x10;
+    async_context_set_work_pending(async->context, &async->completion_worker);
+}
+
+static void completion_worker(async_context_t *context, async_when_pending_worker_t *worker) {
+    dht_async_t *async = worker->user_data;
+    if (async->callback != NULL) {
+        // converted here rather than in the interrupt
+        bool ok = (async->result == DHT_RESULT_OK);
+        float humidity = ok ? 0.1f * async->humidity_x10 : 0.0f;
+        float temperature_c = ok ? 0.1f * async->temperature_c_x10 : 0.0f;
+        async->callback(async->dht, async->result, humidity, temperature_c, async->user_data);
+    }
+}
+
+static void start_worker(async_context_t *context, async_at_time_worker_t *worker) {
+    dht_async_t *async = worker->user_data;
+    // reschedule relative to the previous target time, so the period doesn't drift
+    absolute_time_t next_time = delayed_by_us(worker->next_time, async->period_us);
+    if (async->dht->completion_pending) {
+        // skip this round, the previous measurement hasn't completed
+    } else {
+        dht_start_measurement(async->dht);
+    }
+    async_context_add_at_time_worker_at(context, worker, next_time);
+}
+
+void dht_async_init(dht_async_t *async, async_context_t *context, dht_t *dht, dht_callback_t callback, void *user_data) {
+    memset(async, 0, sizeof(dht_async_t));
+    async->context = context;
+    async->dht = dht;
+    async->callback = callback;
+    async->user_data = user_data;
+    async->completion_worker.do_work = completion_worker;
+    async->completion_worker.user_data = async;
+    async->start_worker.do_work = start_worker;
+    async->start_worker.user_data = async;
+    dht_set_callback_x10(dht, result_callback, async);
+    bool added = async_context_add_when_pending_worker(context, &async->completion_worker);
+    hard_assert(added);
+}
+
+void dht_async_deinit(dht_async_t *async) {
+    dht_async_stop_periodic(async);
+    // don't wait for the measurement in progress, its result is discarded anyway
+    dht_cancel_measurement(async->dht);
+    dht_set_callback(async->dht, NULL, NULL);
+    async_context_remove_when_pending_worker(async->context, &async->completion_worker);
+}
+
+void dht_async_start_measurement(dht_async_t *async) {
+    assert(!async->dht->completion_pending); // measurement in progress
+
+    dht_start_measurement(async->dht);
+}
+
+void dht_async_start_periodic(dht_async_t *async, uint32_t period_us) {
+    uint32_t min_interval_us = dht_get_min_interval_us(async->dht->model);
+    async->period_us = (period_us > min_interval_us) ? period_us : min_interval_us;
+    async_context_remove_at_time_worker(async->context, &async->start_worker);
+    async_context_add_at_time_worker_at(async->context, &async->start_worker, get_absolute_time());
+}
+
+void dht_async_stop_periodic(dht_async_t *async) {
+    async_context_remove_at_time_worker(async->context, &async->start_worker);
+}
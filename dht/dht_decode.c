@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <dht_decode.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+static_assert(sizeof(dht_frame_t) == 8, "frames are packed at an 8-byte stride");
+
+// Per-model encoding, so that batches decode without branching on the model.
+// Each encoding is: humidity = b0 * scale + b1, temperature magnitude =
+// (b2 & t_hi_mask) * scale + (b3 & t_lo_mask), and the sign bit at sign_shift
+// of the payload word negates it (DHT11 reports 0 instead).
+typedef struct batch_params_t {
+    int32_t scale;
+    uint32_t t_hi_mask;
+    uint32_t t_lo_mask;
+    uint32_t sign_shift;
+    int32_t negative_factor;
+} batch_params_t;
+
+static const batch_params_t batch_params[] = {
+    [DHT11] = { .scale = 10, .t_hi_mask = 0xFF, .t_lo_mask = 0x7F, .sign_shift = 31, .negative_factor = 0 },
+    [DHT12] = { .scale = 10, .t_hi_mask = 0xFF, .t_lo_mask = 0x7F, .sign_shift = 31, .negative_factor = -1 },
+    [DHT21] = { .scale = 256, .t_hi_mask = 0x7F, .t_lo_mask = 0xFF, .sign_shift = 23, .negative_factor = -1 },
+    [DHT22] = { .scale = 256, .t_hi_mask = 0x7F, .t_lo_mask = 0xFF, .sign_shift = 23, .negative_factor = -1 },
+};
+// below this spread, all pulses are assumed to encode the same bit value
+static const uint32_t DHT_MIN_PULSE_SEPARATION_US = 20;
+
+uint32_t dht_get_start_pulse_duration_us(dht_model_t model) {
+    return DHT_START_PULSE_DURATION_US(model);
+}
+
+uint32_t dht_get_min_interval_us(dht_model_t model) {
+    return DHT_MIN_INTERVAL_US(model);
+}
+
+int16_t dht_decode_temperature_x10(dht_model_t model, uint8_t b0, uint8_t b1) {
+    int16_t temperature = 0;
+    switch (model) {
+    case DHT11:
+        if (b1 & 0x80) {
+            // below-zero temperature not supported
+            temperature = 0;
+        } else {
+            temperature = b0 * 10 + (b1 & 0x7F);
+        }
+        break;
+    case DHT12:
+        temperature = b0 * 10 + (b1 & 0x7F);
+        if (b1 & 0x80) {
+            temperature = -temperature;
+        }
+        break;
+    case DHT21:
+    case DHT22:
+        temperature = ((b0 & 0x7F) << 8) + b1;
+        if (b0 & 0x80) {
+            temperature = -temperature;
+        }
+        break;
+    default:
+        assert(false); // invalid model
+    }
+    return temperature;
+}
+
+int16_t dht_decode_humidity_x10(dht_model_t model, uint8_t b0, uint8_t b1) {
+    int16_t humidity = 0;
+    switch (model) {
+    case DHT11:
+    case DHT12:
+        humidity = b0 * 10 + b1;
+        break;
+    case DHT21:
+    case DHT22:
+        humidity = (b0 << 8) + b1;
+        break;
+    default:
+        assert(false); // invalid model
+    }
+    return humidity;
+}
+
+uint32_t dht_decode_pulses(const uint32_t pulse_widths_us[DHT_PULSE_COUNT], uint8_t frame[5]) {
+    uint32_t min_width = UINT32_MAX;
+    uint32_t max_width = 0;
+    for (uint32_t i = 0; i < DHT_PULSE_COUNT; i++) {
+        min_width = (pulse_widths_us[i] < min_width) ? pulse_widths_us[i] : min_width;
+        max_width = (pulse_widths_us[i] > max_width) ? pulse_widths_us[i] : max_width;
+    }
+    uint32_t threshold = DHT_LONG_PULSE_THRESHOLD_US;
+    if (max_width - min_width >= DHT_MIN_PULSE_SEPARATION_US) {
+        // both bit values are present, split the widths into two clusters
+        threshold = (min_width + max_width) / 2;
+        for (uint32_t iteration = 0; iteration < 8; iteration++) {
+            uint32_t short_sum = 0, short_count = 0;
+            uint32_t long_sum = 0, long_count = 0;
+            for (uint32_t i = 0; i < DHT_PULSE_COUNT; i++) {
+                if (pulse_widths_us[i] >= threshold) {
+                    long_sum += pulse_widths_us[i];
+                    long_count++;
+                } else {
+                    short_sum += pulse_widths_us[i];
+                    short_count++;
+                }
+            }
+            if (short_count == 0 || long_count == 0) {
+                break;
+            }
+            uint32_t next_threshold = (short_sum / short_count + long_sum / long_count) / 2;
+            if (next_threshold == threshold) {
+                break;
+            }
+            threshold = next_threshold;
+        }
+    }
+    memset(frame, 0, 5);
+    for (uint32_t i = 0; i < DHT_PULSE_COUNT; i++) {
+        if (pulse_widths_us[i] >= threshold) {
+            frame[i / 8] |= 0x80 >> (i % 8);
+        }
+    }
+    return threshold;
+}
+
+dht_result_t dht_decode_frame_x10(dht_model_t model, const uint8_t frame[5], int16_t *humidity_x10, int16_t *temperature_c_x10) {
+    uint8_t checksum = frame[0] + frame[1] + frame[2] + frame[3];
+    if (frame[4] != checksum) {
+        return DHT_RESULT_BAD_CHECKSUM;
+    }
+    *humidity_x10 = dht_decode_humidity_x10(model, frame[0], frame[1]);
+    *temperature_c_x10 = dht_decode_temperature_x10(model, frame[2], frame[3]);
+    return DHT_RESULT_OK;
+}
+
+bool dht_frame_is_plausible(dht_model_t model, const uint8_t frame[5]) {
+    switch (model) {
+    case DHT11:
+    case DHT12:
+        // integer and decimal bytes, at most 100% and 80C
+        return frame[0] <= 100 && frame[1] <= 9 && frame[2] <= 80 && (frame[3] & 0x7F) <= 9;
+    case DHT21:
+    case DHT22:
+        // tenths, at most 100% and 80C in magnitude
+        return ((frame[0] << 8) | frame[1]) <= 1000 && (((frame[2] & 0x7F) << 8) | frame[3]) <= 800;
+    default:
+        assert(false); // invalid model
+        return false;
+    }
+}
+
+dht_model_t dht_resolve_dht1x_model(dht_model_t configured_model) {
+    return (configured_model == DHT11 || configured_model == DHT12) ? configured_model : DHT12;
+}
+
+uint32_t dht_decode_batch(dht_model_t model, const dht_frame_t *frames, uint32_t count, dht_values_x10_t *values, uint32_t *invalid_mask) {
+    assert((uint32_t)model < sizeof(batch_params) / sizeof(batch_params[0])); // invalid model
+    const batch_params_t params = batch_params[model];
+
+    if (invalid_mask != NULL) {
+        memset(invalid_mask, 0, DHT_BATCH_MASK_WORDS(count) * sizeof(uint32_t));
+    }
+    uint32_t invalid_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        // payload bytes b0..b3 as a little-endian word
+        const uint8_t *bytes = frames[i].bytes;
+        uint32_t word = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+        // add bytes in pairs, then fold
+        uint32_t sum = (word & 0x00FF00FF) + ((word >> 8) & 0x00FF00FF);
+        sum = (sum + (sum >> 16)) & 0xFF;
+        uint32_t invalid = (sum != bytes[4]);
+        int32_t valid_mask = (int32_t)invalid - 1; // all ones if valid
+
+        int32_t humidity = (int32_t)(word & 0xFF) * params.scale + (int32_t)((word >> 8) & 0xFF);
+        int32_t magnitude = (int32_t)((word >> 16) & params.t_hi_mask) * params.scale + (int32_t)((word >> 24) & params.t_lo_mask);
+        int32_t negative = (word >> params.sign_shift) & 1;
+        int32_t temperature = magnitude * (1 + negative * (params.negative_factor - 1));
+
+        values[i].humidity_x10 = humidity & valid_mask;
+        values[i].temperature_c_x10 = temperature & valid_mask;
+        if (invalid_mask != NULL) {
+            invalid_mask[i / 32] |= invalid << (i % 32);
+        }
+        invalid_count += invalid;
+    }
+    return invalid_count;
+}
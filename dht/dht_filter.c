@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <dht_filter.h>
+#include <assert.h>
+#include <string.h>
+
+static uint32_t abs_diff(int16_t a, int16_t b) {
+    return (a > b) ? a - b : b - a;
+}
+
+static bool is_outlier(const dht_filter_t *filter, int16_t humidity_x10, int16_t temperature_c_x10) {
+    const dht_filter_config_t *config = &filter->config;
+    if (filter->count == 0) {
+        return false;
+    }
+    if (config->max_humidity_step_x10 != 0 && abs_diff(humidity_x10, filter->last_humidity_x10) > config->max_humidity_step_x10) {
+        return true;
+    }
+    if (config->max_temperature_step_x10 != 0 && abs_diff(temperature_c_x10, filter->last_temperature_c_x10) > config->max_temperature_step_x10) {
+        return true;
+    }
+    return false;
+}
+
+static int16_t get_median(const int16_t *window, uint32_t count) {
+    // insertion sort, the window is tiny
+    int16_t sorted[DHT_FILTER_MAX_WINDOW];
+    for (uint32_t i = 0; i < count; i++) {
+        int16_t value = window[i];
+        uint32_t j = i;
+        for (; j > 0 && sorted[j - 1] > value; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = value;
+    }
+    // lower median for even counts, so the result is always a real reading
+    return sorted[(count - 1) / 2];
+}
+
+static int16_t update_ema(int32_t *ema, int16_t value, uint32_t shift, bool first) {
+    if (first) {
+        *ema = (int32_t)value << shift;
+    } else {
+        // ema += value - ema / 2^shift, kept scaled to avoid losing the fraction
+        *ema += value - (*ema >> shift);
+    }
+    // round to nearest
+    return (*ema + (1 << shift >> 1)) >> shift;
+}
+
+dht_filter_config_t dht_filter_get_default_config(void) {
+    dht_filter_config_t config = {
+        .median_window = 3,
+        .ema_shift = 2,
+        .max_humidity_step_x10 = 100,
+        .max_temperature_step_x10 = 50,
+        .max_rejections = 3,
+    };
+    return config;
+}
+
+void dht_filter_init(dht_filter_t *filter, const dht_filter_config_t *config) {
+    assert(config->median_window <= DHT_FILTER_MAX_WINDOW);
+    assert(config->ema_shift < 16);
+
+    memset(filter, 0, sizeof(dht_filter_t));
+    filter->config = *config;
+}
+
+void dht_filter_reset(dht_filter_t *filter) {
+    dht_filter_config_t config = filter->config;
+    dht_filter_init(filter, &config);
+}
+
+bool dht_filter_update(dht_filter_t *filter, int16_t *humidity_x10, int16_t *temperature_c_x10) {
+    const dht_filter_config_t *config = &filter->config;
+    if (is_outlier(filter, *humidity_x10, *temperature_c_x10)) {
+        if (filter->rejections < config->max_rejections) {
+            filter->rejections++;
+            return false;
+        }
+        // the change persists, follow it
+        dht_filter_reset(filter);
+    }
+    filter->rejections = 0;
+    filter->last_humidity_x10 = *humidity_x10;
+    filter->last_temperature_c_x10 = *temperature_c_x10;
+    bool first = (filter->count == 0);
+
+    uint32_t window = (config->median_window > 1) ? config->median_window : 1;
+    filter->humidity_window[filter->next] = *humidity_x10;
+    filter->temperature_window[filter->next] = *temperature_c_x10;
+    filter->next = (filter->next + 1) % window;
+    if (filter->count < window) {
+        filter->count++;
+    }
+    int16_t humidity = get_median(filter->humidity_window, filter->count);
+    int16_t temperature = get_median(filter->temperature_window, filter->count);
+
+    if (config->ema_shift != 0) {
+        humidity = update_ema(&filter->humidity_ema, humidity, config->ema_shift, first);
+        temperature = update_ema(&filter->temperature_ema, temperature, config->ema_shift, first);
+    }
+    *humidity_x10 = humidity;
+    *temperature_c_x10 = temperature;
+    return true;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <dht_history.h>
+#include <hardware/sync.h>
+#include <string.h>
+
+static_assert((DHT_HISTORY_CAPACITY & (DHT_HISTORY_CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+void dht_history_init(dht_history_t *history) {
+    memset(history, 0, sizeof(dht_history_t));
+}
+
+void dht_history_push(dht_history_t *history, const dht_record_t *record) {
+    uint32_t index = history->write_count;
+    history->records[index % DHT_HISTORY_CAPACITY] = *record;
+    // make the record visible before the new count
+    __dmb();
+    history->write_count = index + 1;
+}
+
+uint dht_history_get_count(const dht_history_t *history) {
+    return MIN(history->write_count, DHT_HISTORY_CAPACITY);
+}
+
+bool dht_history_get(const dht_history_t *history, uint age, dht_record_t *record) {
+    while (true) {
+        uint32_t count = history->write_count;
+        if (age >= MIN(count, DHT_HISTORY_CAPACITY)) {
+            return false;
+        }
+        uint32_t index = count - 1 - age;
+        __dmb();
+        *record = history->records[index % DHT_HISTORY_CAPACITY];
+        __dmb();
+        // While writing record N the count is still N, so a slot is only safe if
+        // it wasn't reused by any write that started before the copy finished.
+        if (index + DHT_HISTORY_CAPACITY > history->write_count) {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <dht_log.h>
+#include <hardware/sync.h>
+#include <pico/flash.h>
+#include <stdio.h>
+#include <string.h>
+
+// how long flash_safe_execute() may wait for the other core
+#ifndef DHT_LOG_FLASH_TIMEOUT_MS
+#define DHT_LOG_FLASH_TIMEOUT_MS 100
+#endif
+
+static_assert(sizeof(dht_log_record_t) == 8, "");
+static_assert(sizeof(dht_log_page_header_t) == 16, "");
+
+typedef struct program_params_t {
+    uint32_t flash_offset;
+    const uint8_t *data;
+    bool erase;
+} program_params_t;
+
+static const dht_log_page_header_t *get_flash_page(const dht_log_t *log, uint32_t page) {
+    return (const dht_log_page_header_t *)(uintptr_t)(XIP_BASE + log->flash_offset + page * FLASH_PAGE_SIZE);
+}
+
+static dht_log_record_t *get_records(uint8_t *page) {
+    return (dht_log_record_t *)(page + sizeof(dht_log_page_header_t));
+}
+
+static void close_page(dht_log_t *log) {
+    // make the records visible before handing the page over
+    __dmb();
+    log->page_ready[log->fill_page] = true;
+    log->fill_page ^= 1;
+    log->record_count = 0;
+}
+
+// runs with interrupts disabled and the other core paused
+static void program_page(void *param) {
+    const program_params_t *params = param;
+    if (params->erase) {
+        flash_range_erase(params->flash_offset, FLASH_SECTOR_SIZE);
+    }
+    flash_range_program(params->flash_offset, params->data, FLASH_PAGE_SIZE);
+}
+
+static bool write_page(dht_log_t *log, uint index) {
+    uint8_t *page = log->pages[index];
+    ((dht_log_page_header_t *)page)->sequence = log->next_sequence;
+    program_params_t params = {
+        .flash_offset = log->flash_offset + log->next_page * FLASH_PAGE_SIZE,
+        .data = page,
+        // entering a new sector drops the oldest one
+        .erase = (log->next_page * FLASH_PAGE_SIZE) % FLASH_SECTOR_SIZE == 0,
+    };
+    if (flash_safe_execute(program_page, &params, DHT_LOG_FLASH_TIMEOUT_MS) != PICO_OK) {
+        return false; // try again on the next call
+    }
+    log->next_sequence++;
+    log->next_page = (log->next_page + 1) % log->page_count;
+    memset(page, 0xFF, FLASH_PAGE_SIZE);
+    __dmb();
+    log->page_ready[index] = false;
+    return true;
+}
+
+void dht_log_init(dht_log_t *log, uint32_t flash_offset, uint32_t size) {
+    assert(flash_offset % FLASH_SECTOR_SIZE == 0);
+    assert(size != 0 && size % FLASH_SECTOR_SIZE == 0);
+
+    memset(log, 0, sizeof(dht_log_t));
+    memset(log->pages, 0xFF, sizeof(log->pages));
+    log->flash_offset = flash_offset;
+    log->page_count = size / FLASH_PAGE_SIZE;
+
+    // resume after the newest page
+    bool found = false;
+    uint32_t newest_sequence = 0;
+    for (uint32_t page = 0; page < log->page_count; page++) {
+        const dht_log_page_header_t *header = get_flash_page(log, page);
+        if (header->magic != DHT_LOG_PAGE_MAGIC) {
+            continue;
+        }
+        if (!found || (int32_t)(header->sequence - newest_sequence) > 0) {
+            found = true;
+            newest_sequence = header->sequence;
+            log->next_page = (page + 1) % log->page_count;
+        }
+    }
+    log->next_sequence = found ? newest_sequence + 1 : 0;
+}
+
+bool dht_log_append(dht_log_t *log, uint8_t sensor_id, dht_result_t result, int16_t humidity_x10, int16_t temperature_c_x10, uint64_t time_ms) {
+    assert(sensor_id != DHT_LOG_UNUSED_SENSOR_ID);
+
+    uint64_t delta = 0;
+    if (log->record_count != 0) {
+        delta = (time_ms >= log->last_time_ms) ? (time_ms - log->last_time_ms) / DHT_LOG_TIME_UNIT_MS : UINT64_MAX;
+        if (delta > UINT16_MAX) {
+            // too far from the previous record, start a new page with its own base time
+            close_page(log);
+            delta = 0;
+        }
+    }
+    if (log->page_ready[log->fill_page]) {
+        log->dropped_count++;
+        return false;
+    }
+    uint8_t *page = log->pages[log->fill_page];
+    if (log->record_count == 0) {
+        dht_log_page_header_t *header = (dht_log_page_header_t *)page;
+        header->magic = DHT_LOG_PAGE_MAGIC;
+        header->base_time_ms = time_ms;
+        log->last_time_ms = time_ms;
+    }
+    bool ok = (result == DHT_RESULT_OK);
+    dht_log_record_t *record = &get_records(page)[log->record_count];
+    record->sensor_id = sensor_id;
+    record->result = result;
+    record->delta_time = delta;
+    record->temperature_c_x10 = ok ? temperature_c_x10 : 0;
+    record->humidity_x10 = ok ? humidity_x10 : 0;
+    // track the time as decoded from deltas, so rounding errors don't add up
+    log->last_time_ms += delta * DHT_LOG_TIME_UNIT_MS;
+    if (++log->record_count == DHT_LOG_RECORDS_PER_PAGE) {
+        close_page(log);
+    }
+    return true;
+}
+
+void dht_log_task(dht_log_t *log) {
+    // if both pages are ready, the one being filled next is the older one
+    uint first = log->fill_page;
+    for (uint i = 0; i < 2; i++) {
+        uint index = first ^ i;
+        if (log->page_ready[index] && !write_page(log, index)) {
+            return;
+        }
+    }
+}
+
+void dht_log_flush(dht_log_t *log) {
+    if (log->record_count != 0) {
+        close_page(log);
+    }
+    dht_log_task(log);
+}
+
+uint dht_log_dump(const dht_log_t *log) {
+    uint count = 0;
+    // oldest page first: after a wrap, the page about to be written is the oldest
+    for (uint32_t i = 0; i < log->page_count; i++) {
+        uint32_t page = (log->next_page + i) % log->page_count;
+        const dht_log_page_header_t *header = get_flash_page(log, page);
+        if (header->magic != DHT_LOG_PAGE_MAGIC) {
+            continue;
+        }
+        const uint8_t *bytes = (const uint8_t *)header;
+        for (uint j = 0; j < FLASH_PAGE_SIZE; j++) {
+            putchar_raw(bytes[j]);
+        }
+        count++;
+    }
+    return count;
+}
+
+uint32_t dht_log_get_dropped_count(const dht_log_t *log) {
+    return log->dropped_count;
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "dht_pio_program.h"
+#include "dht_timing.h"
+#include <dht_multi.h>
+#include <dht_multi.pio.h>
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <pico/stdlib.h>
+#include <string.h>
+
+#define DHT_FRAME_BITS 40
+
+// the PIO program samples 16 pins every 10 clocks, i.e. every 10us at the
+// default 1MHz; the sample buffer is sized for that, so the rate is fixed
+static_assert(DHT_MULTI_MAX_PINS == dht_multi_sample_pins, "");
+static_assert(DHT_MULTI_SAMPLE_PERIOD_US == dht_multi_sample_clocks, "");
+
+//
+// misc
+//
+
+// the PIO program is shared by all instances on the same PIO block
+static dht_pio_program_t pio_program = { .program = &dht_multi_program };
+
+// Derive the clock divider from the current clk_sys, and the start signal from
+// the frequency actually obtained, like update_timing() in dht.c.
+static uint32_t update_timing(dht_multi_t *multi) {
+    uint32_t sys_clock_frequency = clock_get_hz(clk_sys);
+    uint32_t clkdiv_x256 = dht_get_clkdiv_x256(sys_clock_frequency, DHT_PIO_SM_CLOCK_FREQUENCY);
+    uint32_t actual_pio_clock_frequency = dht_get_actual_pio_clock_frequency(sys_clock_frequency, clkdiv_x256);
+    multi->start_signal_loops = dht_get_pio_sm_loops(actual_pio_clock_frequency, dht_get_start_pulse_duration_us(multi->model), dht_multi_start_signal_clocks_per_loop);
+    return clkdiv_x256;
+}
+
+static void dht_multi_program_init(PIO pio, uint sm, uint offset, uint base_pin, uint pin_count, uint32_t clkdiv_x256) {
+    pio_sm_config c = dht_multi_program_get_default_config(offset);
+    sm_config_set_clkdiv_int_frac(&c, clkdiv_x256 >> 8, clkdiv_x256 & 0xFF);
+    sm_config_set_out_pins(&c, base_pin, pin_count);
+    sm_config_set_in_pins(&c, base_pin);
+    // samples are shifted to the right, so they're stored in order as 16-bit halves
+    sm_config_set_in_shift(&c, true /* shift_right */, true /* autopush */, 32 /* push_threshold */);
+    pio_sm_init(pio, sm, offset, &c);
+
+    uint32_t pin_mask = ((1u << pin_count) - 1) << base_pin;
+    pio_sm_set_pins_with_mask(pio, sm, 0, pin_mask);
+}
+
+static void dht_multi_program_restart(PIO pio, uint sm, uint offset, uint32_t start_signal_loops) {
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+    pio_sm_exec(pio, sm, pio_encode_jmp(offset));
+
+    // push timing value
+    pio_sm_put(pio, sm, start_signal_loops);
+    // pull the start-signal duration
+    pio_sm_exec(pio, sm, pio_encode_pull(/* if_empty */ false, /* block */ true));
+    // store it in Y register for the loop
+    pio_sm_exec(pio, sm, pio_encode_mov(pio_y, pio_osr));
+    // drive all data pins low to wake sensors
+    pio_sm_exec(pio, sm, pio_encode_mov_not(pio_osr, pio_null));
+    pio_sm_exec(pio, sm, pio_encode_out(pio_pindirs, 32));
+}
+
+static void configure_dma_channel(uint chan, PIO pio, uint sm, uint16_t *write_addr) {
+    dma_channel_config c = dma_channel_get_default_config(chan);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false /* is_tx */));
+    channel_config_set_irq_quiet(&c, true);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    dma_channel_configure(chan, &c, write_addr, &pio->rxf[sm], DHT_MULTI_SAMPLE_COUNT / 2, false /* trigger */);
+}
+
+static dht_result_t decode_pin(const dht_multi_t *multi, uint pin_index, uint8_t frame[5]) {
+    // The line carries a few high pulses before the payload (bus release, sensor
+    // response). Payload bits are the last 40 complete high pulses.
+    uint8_t widths[DHT_FRAME_BITS];
+    uint pulse_count = 0;
+    uint rise = 0;
+    bool rise_seen = false;
+    bool prev_level = true;
+    for (uint i = 0; i < DHT_MULTI_SAMPLE_COUNT; i++) {
+        bool level = (multi->samples[i] >> pin_index) & 1;
+        if (level && !prev_level) {
+            rise = i;
+            rise_seen = true;
+        } else if (!level && prev_level && rise_seen) {
+            widths[pulse_count % DHT_FRAME_BITS] = i - rise;
+            pulse_count++;
+        }
+        prev_level = level;
+    }
+    if (pulse_count < DHT_FRAME_BITS) {
+        return DHT_RESULT_TIMEOUT;
+    }
+    memset(frame, 0, 5);
+    for (uint bit = 0; bit < DHT_FRAME_BITS; bit++) {
+        uint width = widths[(pulse_count + bit) % DHT_FRAME_BITS];
+        if (width * DHT_MULTI_SAMPLE_PERIOD_US >= DHT_LONG_PULSE_THRESHOLD_US) {
+            frame[bit / 8] |= 0x80 >> (bit % 8);
+        }
+    }
+    return DHT_RESULT_OK;
+}
+
+static void stop_sampling(dht_multi_t *multi) {
+    pio_sm_set_enabled(multi->pio, multi->sm, false);
+    // make sure pins are left in hi-z mode
+    pio_sm_exec(multi->pio, multi->sm, pio_encode_mov(pio_osr, pio_null));
+    pio_sm_exec(multi->pio, multi->sm, pio_encode_out(pio_pindirs, 32));
+}
+
+static void finish_measurement(dht_multi_t *multi, dht_reading_t *readings) {
+    stop_sampling(multi);
+    for (uint i = 0; i < multi->pin_count; i++) {
+        uint8_t frame[5];
+        readings[i].result = decode_pin(multi, i, frame);
+        if (readings[i].result == DHT_RESULT_OK) {
+            int16_t humidity_x10, temperature_c_x10;
+            readings[i].result = dht_decode_frame_x10(multi->model, frame, &humidity_x10, &temperature_c_x10);
+            readings[i].humidity = 0.1f * humidity_x10;
+            readings[i].temperature_c = 0.1f * temperature_c_x10;
+        }
+    }
+}
+
+static void finish_raw_measurement(dht_multi_t *multi, dht_frame_t *frames, dht_result_t *results) {
+    stop_sampling(multi);
+    for (uint i = 0; i < multi->pin_count; i++) {
+        uint8_t *frame = frames[i].bytes;
+        results[i] = decode_pin(multi, i, frame);
+        if (results[i] == DHT_RESULT_OK && (uint8_t)(frame[0] + frame[1] + frame[2] + frame[3]) != frame[4]) {
+            results[i] = DHT_RESULT_BAD_CHECKSUM;
+        }
+    }
+}
+
+static bool pio_sm_is_enabled(PIO pio, uint sm) {
+    return (pio->ctrl & (1 << sm)) != 0;
+}
+
+//
+// public interface
+//
+
+void dht_multi_init(dht_multi_t *multi, dht_model_t model, PIO pio, uint8_t base_pin, uint8_t pin_count, bool pull_up) {
+    assert(pio_get_index(pio) < NUM_PIOS);
+    assert(pin_count > 0 && pin_count <= DHT_MULTI_MAX_PINS);
+
+    memset(multi, 0, sizeof(dht_multi_t));
+    multi->model = model;
+    multi->pio = pio;
+    multi->pio_program_offset = dht_pio_program_acquire(&pio_program, pio);
+    multi->sm = pio_claim_unused_sm(pio, true /* required */);
+    multi->dma_chan = dma_claim_unused_channel(true /* required */);
+    multi->base_pin = base_pin;
+    multi->pin_count = pin_count;
+
+    for (uint pin = base_pin; pin < base_pin + pin_count; pin++) {
+        pio_gpio_init(pio, pin);
+        gpio_set_pulls(pin, pull_up, false /* down */);
+    }
+    dht_multi_program_init(pio, multi->sm, multi->pio_program_offset, base_pin, pin_count, update_timing(multi));
+    configure_dma_channel(multi->dma_chan, pio, multi->sm, multi->samples);
+}
+
+void dht_multi_deinit(dht_multi_t *multi) {
+    assert(multi->pio != NULL); // not initialized
+
+    dma_channel_abort(multi->dma_chan);
+    dma_channel_unclaim(multi->dma_chan);
+
+    pio_sm_set_enabled(multi->pio, multi->sm, false);
+    // make sure pins are left in hi-z mode; original pin functions & pulls are not restored
+    pio_sm_set_consecutive_pindirs(multi->pio, multi->sm, multi->base_pin, multi->pin_count, false /* is_out */);
+    pio_sm_unclaim(multi->pio, multi->sm);
+    dht_pio_program_release(&pio_program, multi->pio);
+
+    multi->pio = NULL;
+}
+
+void dht_multi_sync_clock(dht_multi_t *multi) {
+    assert(multi->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(multi->pio, multi->sm)); // measurement in progress
+
+    // the start signal is pushed on every start, so the next measurement picks it up
+    uint32_t clkdiv_x256 = update_timing(multi);
+    pio_sm_set_clkdiv_int_frac(multi->pio, multi->sm, clkdiv_x256 >> 8, clkdiv_x256 & 0xFF);
+}
+
+void dht_multi_start_measurement(dht_multi_t *multi) {
+    assert(multi->pio != NULL); // not initialized
+    assert(!pio_sm_is_enabled(multi->pio, multi->sm)); // another measurement in progress
+
+    dht_multi_program_restart(multi->pio, multi->sm, multi->pio_program_offset, multi->start_signal_loops);
+    dma_channel_transfer_to_buffer_now(multi->dma_chan, multi->samples, DHT_MULTI_SAMPLE_COUNT / 2);
+    // start executing the PIO program
+    pio_sm_set_enabled(multi->pio, multi->sm, true);
+    multi->start_time = time_us_32();
+}
+
+dht_result_t dht_multi_try_finish_measurement(dht_multi_t *multi, dht_reading_t *readings) {
+    assert(multi->pio != NULL); // not initialized
+    assert(pio_sm_is_enabled(multi->pio, multi->sm)); // no measurement in progress
+
+    // sampling always runs for the full capture window
+    if (dma_channel_is_busy(multi->dma_chan)) {
+        return DHT_RESULT_IN_PROGRESS;
+    }
+    finish_measurement(multi, readings);
+    return DHT_RESULT_OK;
+}
+
+void dht_multi_finish_measurement_blocking(dht_multi_t *multi, dht_reading_t *readings) {
+    assert(multi->pio != NULL); // not initialized
+    assert(pio_sm_is_enabled(multi->pio, multi->sm)); // no measurement in progress
+
+    while (dma_channel_is_busy(multi->dma_chan)) {
+        tight_loop_contents();
+    }
+    finish_measurement(multi, readings);
+}
+
+dht_result_t dht_multi_try_finish_measurement_raw(dht_multi_t *multi, dht_frame_t *frames, dht_result_t *results) {
+    assert(multi->pio != NULL); // not initialized
+    assert(pio_sm_is_enabled(multi->pio, multi->sm)); // no measurement in progress
+
+    if (dma_channel_is_busy(multi->dma_chan)) {
+        return DHT_RESULT_IN_PROGRESS;
+    }
+    finish_raw_measurement(multi, frames, results);
+    return DHT_RESULT_OK;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "dht_pio_program.h"
+#include <assert.h>
+
+uint dht_pio_program_acquire(dht_pio_program_t *shared, PIO pio) {
+    uint pio_index = pio_get_index(pio);
+    if (shared->ref_count[pio_index] == 0) {
+        shared->offset[pio_index] = pio_add_program(pio, shared->program);
+    }
+    shared->ref_count[pio_index]++;
+    return shared->offset[pio_index];
+}
+
+void dht_pio_program_release(dht_pio_program_t *shared, PIO pio) {
+    uint pio_index = pio_get_index(pio);
+    assert(shared->ref_count[pio_index] > 0);
+    shared->ref_count[pio_index]--;
+    if (shared->ref_count[pio_index] == 0) {
+        pio_remove_program(pio, shared->program, shared->offset[pio_index]);
+    }
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_PIO_PROGRAM_H_
+#define _DHT_PIO_PROGRAM_H_
+
+// Internal to the library: PIO programs loaded once per PIO block, and shared
+// by all sensors (or sensor sets) running them there.
+
+#include <hardware/pio.h>
+
+typedef struct dht_pio_program_t {
+    const pio_program_t *program;
+    uint8_t ref_count[NUM_PIOS];
+    uint8_t offset[NUM_PIOS];
+} dht_pio_program_t;
+
+// Loads the program on first use, and returns its offset.
+uint dht_pio_program_acquire(dht_pio_program_t *shared, PIO pio);
+
+// Removes the program once the last user releases it.
+void dht_pio_program_release(dht_pio_program_t *shared, PIO pio);
+
+static inline bool dht_pio_program_is_loaded(const dht_pio_program_t *shared, PIO pio) {
+    return shared->ref_count[pio_get_index(pio)] > 0;
+}
+
+#endif // _DHT_PIO_PROGRAM_H_
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <dht_scheduler.h>
+#include <string.h>
+
+static int64_t alarm_callback(alarm_id_t id, void *user_data);
+
+static void schedule(dht_scheduler_entry_t *entry, absolute_time_t time) {
+    entry->alarm = alarm_pool_add_alarm_at(entry->scheduler->alarm_pool, time, alarm_callback, entry, true /* fire_if_past */);
+    hard_assert(entry->alarm >= 0); // no alarm slots left
+}
+
+// sampling period, stretched while backing off from an unresponsive sensor
+static uint64_t get_round_period_us(const dht_scheduler_entry_t *entry) {
+    return (uint64_t)entry->period_us << entry->backoff_shift;
+}
+
+static bool is_corrupted(dht_result_t result) {
+    return result == DHT_RESULT_BAD_CHECKSUM || result == DHT_RESULT_STALLED;
+}
+
+static void report(dht_scheduler_entry_t *entry, dht_result_t result, int16_t humidity_x10, int16_t temperature_c_x10) {
+    if (entry->callback_x10 != NULL) {
+        entry->callback_x10(entry->dht, result, humidity_x10, temperature_c_x10, entry->user_data);
+    } else if (entry->callback != NULL) {
+        bool ok = (result == DHT_RESULT_OK);
+        entry->callback(entry->dht, result, ok ? 0.1f * humidity_x10 : 0.0f, ok ? 0.1f * temperature_c_x10 : 0.0f, entry->user_data);
+    }
+}
+
+static void result_callback(dht_t *dht, dht_result_t result, int16_t humidity_x10, int16_t temperature_c_x10, void *user_data) {
+    dht_scheduler_entry_t *entry = user_data;
+    if (!entry->scheduler->running || entry->alarm != 0) {
+        // stopped, or restarted while the measurement was in progress: report
+        // the result, but leave scheduling alone
+        report(entry, result, humidity_x10, temperature_c_x10);
+        return;
+    }
+    absolute_time_t next_round_time = delayed_by_us(entry->round_time, get_round_period_us(entry));
+    if (is_corrupted(result) && entry->retry_count < entry->policy.max_retries) {
+        absolute_time_t retry_time = delayed_by_us(entry->attempt_time, dht_get_min_interval_us(dht->model));
+        if (absolute_time_diff_us(retry_time, next_round_time) > 0) {
+            entry->retry_count++;
+            schedule(entry, retry_time);
+            return;
+        }
+    }
+    if (result == DHT_RESULT_OK) {
+        entry->backoff_shift = 0;
+    } else if (!is_corrupted(result) && entry->backoff_shift < entry->policy.max_backoff_shift) {
+        // probe unresponsive sensors progressively less often
+        entry->backoff_shift++;
+    }
+    entry->retry_count = 0;
+    entry->round_time = next_round_time;
+    schedule(entry, next_round_time);
+    report(entry, result, humidity_x10, temperature_c_x10);
+}
+
+static int64_t alarm_callback(alarm_id_t id, void *user_data) {
+    dht_scheduler_entry_t *entry = user_data;
+    // skip this round if the previous measurement hasn't completed
+    if (entry->dht->completion_pending) {
+        uint64_t round_period_us = get_round_period_us(entry);
+        entry->round_time = delayed_by_us(entry->round_time, round_period_us);
+        // reschedule relative to the previous target time, so the period doesn't drift
+        return -(int64_t)round_period_us;
+    }
+    // the next alarm is scheduled once the result is known
+    entry->alarm = 0;
+    entry->attempt_time = get_absolute_time();
+    dht_start_measurement(entry->dht);
+    return 0;
+}
+
+void dht_scheduler_init(dht_scheduler_t *scheduler, alarm_pool_t *alarm_pool, uint32_t period_us) {
+    memset(scheduler, 0, sizeof(dht_scheduler_t));
+    scheduler->alarm_pool = (alarm_pool != NULL) ? alarm_pool : alarm_pool_get_default();
+    scheduler->period_us = period_us;
+}
+
+static uint add_sensor(dht_scheduler_t *scheduler, dht_t *dht, dht_callback_t callback, dht_callback_x10_t callback_x10, void *user_data) {
+    assert(!scheduler->running);
+    assert(scheduler->count < DHT_SCHEDULER_MAX_SENSORS); // too many sensors
+
+    uint index = scheduler->count++;
+    dht_scheduler_entry_t *entry = &scheduler->entries[index];
+    entry->scheduler = scheduler;
+    entry->dht = dht;
+    entry->callback = callback;
+    entry->callback_x10 = callback_x10;
+    entry->user_data = user_data;
+    uint32_t min_interval_us = dht_get_min_interval_us(dht->model);
+    entry->period_us = (scheduler->period_us > min_interval_us) ? scheduler->period_us : min_interval_us;
+    entry->policy.max_retries = DHT_SCHEDULER_DEFAULT_MAX_RETRIES;
+    entry->policy.max_backoff_shift = DHT_SCHEDULER_DEFAULT_MAX_BACKOFF_SHIFT;
+    dht_set_callback_x10(dht, result_callback, entry);
+    return index;
+}
+
+uint dht_scheduler_add(dht_scheduler_t *scheduler, dht_t *dht, dht_callback_t callback, void *user_data) {
+    return add_sensor(scheduler, dht, callback, NULL, user_data);
+}
+
+uint dht_scheduler_add_x10(dht_scheduler_t *scheduler, dht_t *dht, dht_callback_x10_t callback, void *user_data) {
+    return add_sensor(scheduler, dht, NULL, callback, user_data);
+}
+
+void dht_scheduler_set_retry_policy(dht_scheduler_t *scheduler, uint index, const dht_retry_policy_t *policy) {
+    assert(!scheduler->running);
+    assert(index < scheduler->count);
+    assert(policy->max_backoff_shift < 32);
+
+    scheduler->entries[index].policy = *policy;
+}
+
+void dht_scheduler_start(dht_scheduler_t *scheduler) {
+    assert(!scheduler->running);
+
+    scheduler->running = true;
+    absolute_time_t now = get_absolute_time();
+    for (uint i = 0; i < scheduler->count; i++) {
+        dht_scheduler_entry_t *entry = &scheduler->entries[i];
+        entry->retry_count = 0;
+        entry->backoff_shift = 0;
+        // spread start pulses evenly over the period
+        entry->round_time = delayed_by_us(now, (uint64_t)entry->period_us * (i + 1) / scheduler->count);
+        schedule(entry, entry->round_time);
+    }
+}
+
+void dht_scheduler_stop(dht_scheduler_t *scheduler) {
+    assert(scheduler->running);
+
+    scheduler->running = false;
+    for (uint i = 0; i < scheduler->count; i++) {
+        alarm_pool_cancel_alarm(scheduler->alarm_pool, scheduler->entries[i].alarm);
+        scheduler->entries[i].alarm = 0;
+    }
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <dht_service.h>
+#include <hardware/sync.h>
+#include <pico/multicore.h>
+#include <pico/stdlib.h>
+
+static_assert((DHT_SERVICE_QUEUE_SIZE & (DHT_SERVICE_QUEUE_SIZE - 1)) == 0, "queue size must be a power of two");
+
+typedef struct service_entry_t {
+    dht_t *dht;
+    uint32_t period_us;
+    uint64_t next_start_time;
+    bool measuring;
+} service_entry_t;
+
+static service_entry_t entries[DHT_SERVICE_MAX_SENSORS];
+static uint entry_count;
+static bool notify_core0;
+
+// single-producer (core 1), single-consumer (core 0) queue
+static dht_service_reading_t queue[DHT_SERVICE_QUEUE_SIZE];
+static volatile uint32_t queue_head; // written by core 1
+static volatile uint32_t queue_tail; // written by core 0
+static volatile uint32_t dropped_count;
+
+static void publish(const dht_service_reading_t *reading) {
+    uint32_t head = queue_head;
+    if (head - queue_tail == DHT_SERVICE_QUEUE_SIZE) {
+        dropped_count++;
+        return;
+    }
+    queue[head % DHT_SERVICE_QUEUE_SIZE] = *reading;
+    // make the reading visible before the new head
+    __dmb();
+    queue_head = head + 1;
+
+    if (notify_core0) {
+        multicore_fifo_push_timeout_us(reading->sensor_index, 0);
+    }
+}
+
+static void service_main(void) {
+    uint64_t now = time_us_64();
+    for (uint i = 0; i < entry_count; i++) {
+        // spread start pulses evenly over the period
+        entries[i].next_start_time = now + (uint64_t)entries[i].period_us * i / entry_count;
+    }
+    while (true) {
+        now = time_us_64();
+        bool measuring = false;
+        uint64_t next_start_time = UINT64_MAX;
+        for (uint i = 0; i < entry_count; i++) {
+            service_entry_t *entry = &entries[i];
+            if (entry->measuring) {
+                dht_service_reading_t reading;
+                dht_result_t result = dht_try_finish_measurement_x10(entry->dht, &reading.humidity_x10, &reading.temperature_c_x10);
+                if (result != DHT_RESULT_IN_PROGRESS) {
+                    reading.time_us = time_us_64();
+                    reading.sensor_index = i;
+                    reading.result = result;
+                    publish(&reading);
+                    entry->measuring = false;
+                }
+            } else if (now >= entry->next_start_time) {
+                dht_start_measurement(entry->dht);
+                entry->measuring = true;
+                entry->next_start_time += entry->period_us;
+                if (entry->next_start_time < now) {
+                    // fell behind, don't try to catch up
+                    entry->next_start_time = now + entry->period_us;
+                }
+            }
+            measuring |= entry->measuring;
+            next_start_time = MIN(next_start_time, entry->next_start_time);
+        }
+        if (!measuring) {
+            sleep_until(from_us_since_boot(next_start_time));
+        }
+    }
+}
+
+uint dht_service_add(dht_t *dht, uint32_t period_us) {
+    assert(entry_count < DHT_SERVICE_MAX_SENSORS); // too many sensors
+    assert(dht->callback == NULL && dht->callback_x10 == NULL); // service polls for results
+
+    service_entry_t *entry = &entries[entry_count];
+    entry->dht = dht;
+    entry->period_us = MAX(period_us, dht_get_min_interval_us(dht->model));
+    entry->measuring = false;
+    return entry_count++;
+}
+
+void dht_service_start(bool notify) {
+    notify_core0 = notify;
+    multicore_launch_core1(service_main);
+}
+
+bool dht_service_read(dht_service_reading_t *reading) {
+    uint32_t tail = queue_tail;
+    if (tail == queue_head) {
+        return false;
+    }
+    // read the reading only after seeing the new head
+    __dmb();
+    *reading = queue[tail % DHT_SERVICE_QUEUE_SIZE];
+    __dmb();
+    queue_tail = tail + 1;
+    return true;
+}
+
+uint32_t dht_service_get_dropped_count(void) {
+    return dropped_count;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_TIMING_H_
+#define _DHT_TIMING_H_
+
+// Internal to the library: measurement deadlines and state machine timing
+// shared by the drivers. Doesn't depend on the Pico SDK, so the host tests
+// replay with the same numbers.
+
+#include <stdint.h>
+
+#define DHT_MEASUREMENT_TIMEOUT_US 6000
+// sensor must start its response (pull the line low) this long after the start signal
+#define DHT_RESPONSE_TIMEOUT_US 200
+// upper bound for the acknowledge (low + high pulse) once the response started
+#define DHT_ACKNOWLEDGE_TIMEOUT_US 200
+// upper bound for a data bit (low + high pulse) with some margin
+#define DHT_BIT_TIMEOUT_US 150
+
+// Clock divider in 16.8 fixed point, from 1 (full speed) up to 65535 + 255/256,
+// nearest to the requested state machine clock.
+static inline uint32_t dht_get_clkdiv_x256(uint32_t sys_clock_frequency, uint32_t pio_clock_frequency) {
+    uint64_t clkdiv_x256 = ((uint64_t)sys_clock_frequency * 256 + pio_clock_frequency / 2) / pio_clock_frequency;
+    if (clkdiv_x256 < 256) {
+        return 256;
+    }
+    return (clkdiv_x256 > 0xFFFFFF) ? 0xFFFFFF : (uint32_t)clkdiv_x256;
+}
+
+// State machine clock actually obtained with the divider.
+static inline uint32_t dht_get_actual_pio_clock_frequency(uint32_t sys_clock_frequency, uint32_t clkdiv_x256) {
+    return (uint64_t)sys_clock_frequency * 256 / clkdiv_x256;
+}
+
+// Number of program loops spanning the given duration, at the actual state machine clock.
+static inline uint32_t dht_get_pio_sm_loops(uint32_t actual_pio_clock_frequency, uint32_t us, uint32_t clocks_per_loop) {
+    uint64_t clocks = ((uint64_t)us * actual_pio_clock_frequency + 500000) / 1000000;
+    return (clocks + clocks_per_loop / 2) / clocks_per_loop;
+}
+
+#endif // _DHT_TIMING_H_
@@ -7,7 +7,9 @@
 #ifndef _DHT_H_
 #define _DHT_H_
 
+#include <dht_decode.h>
 #include <hardware/pio.h>
+#include <pico/time.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -20,19 +22,120 @@ extern "C" {
  */
 
 /**
- * \brief DHT sensor model.
+ * \brief Enable per-sensor statistics.
+ *
+ * Define as 1 for all sources using the library (e.g. with
+ * target_compile_definitions) to collect measurement statistics in dht_t.
+ */
+#ifndef DHT_STATS_ENABLED
+#define DHT_STATS_ENABLED 0
+#endif
+
+/** \brief Default state machine clock rate: one tick per microsecond. */
+#define DHT_PIO_SM_CLOCK_FREQUENCY 1000000
+
+/** \brief Number of latency histogram buckets. The last one also counts higher latencies. */
+#define DHT_STATS_LATENCY_BUCKETS 16
+
+/** \brief Width of a latency histogram bucket. */
+#define DHT_STATS_LATENCY_BUCKET_US 2000
+
+#if DHT_STATS_ENABLED
+/**
+ * \brief Measurement statistics.
+ *
+ * Latency is measured from the start of a measurement until the library
+ * completes it. In callback mode, that is when the last byte arrives (or,
+ * without DMA, at the next FIFO poll, 250us at most). When polling, it also
+ * includes any delay until the finish call that collects the result, so it
+ * reflects the polling interval as much as the sensor.
+ */
+typedef struct dht_stats_t {
+    uint32_t ok_count; /**< Successful measurements. */
+    uint32_t timeout_count; /**< Measurements ending with DHT_RESULT_TIMEOUT. */
+    uint32_t bad_checksum_count; /**< Measurements ending with DHT_RESULT_BAD_CHECKSUM. */
+    uint32_t no_response_count; /**< Measurements ending with DHT_RESULT_NO_RESPONSE. */
+    uint32_t stalled_count; /**< Measurements ending with DHT_RESULT_STALLED. */
+    uint32_t retry_count; /**< Measurements started after a failed one. */
+    uint32_t latency_min_us; /**< Minimum time from start to completion. */
+    uint32_t latency_max_us; /**< Maximum time from start to completion. */
+    uint32_t latency_histogram[DHT_STATS_LATENCY_BUCKETS]; /**< Successful measurements by latency. */
+} dht_stats_t;
+#endif
+
+typedef struct dht_t dht_t;
+typedef struct dht_history_t dht_history_t;
+typedef struct dht_filter_t dht_filter_t;
+
+/**
+ * \brief Measurement completion callback.
+ *
+ * Called from interrupt context when a measurement completes.
+ *
+ * \param dht DHT sensor.
+ * \param result Result status.
+ * \param humidity Relative humidity. Only valid if result is DHT_RESULT_OK.
+ * \param temperature_c Degrees Celsius. Only valid if result is DHT_RESULT_OK.
+ * \param user_data User data passed to dht_set_callback().
+ */
+typedef void (*dht_callback_t)(dht_t *dht, dht_result_t result, float humidity, float temperature_c, void *user_data);
+
+/**
+ * \brief Measurement completion callback with fixed-point values.
+ *
+ * Same as dht_callback_t, but values are passed as integer tenths, so the
+ * interrupt doesn't need any floating point math.
+ *
+ * \param dht DHT sensor.
+ * \param result Result status.
+ * \param humidity_x10 Relative humidity, in tenths of a percent. Only valid if result is DHT_RESULT_OK.
+ * \param temperature_c_x10 Tenths of a degree Celsius. Only valid if result is DHT_RESULT_OK.
+ * \param user_data User data passed to dht_set_callback_x10().
+ */
+typedef void (*dht_callback_x10_t)(dht_t *dht, dht_result_t result, int16_t humidity_x10, int16_t temperature_c_x10, void *user_data);
+
+/**
+ * \brief Sensor configuration.
  */
-typedef enum dht_model_t {
-    DHT11,
-    DHT12,
-    DHT21,
-    DHT22,
-} dht_model_t;
+typedef struct dht_config_t {
+    dht_model_t model; /**< DHT sensor model. */
+    PIO pio; /**< PIO block to use, or NULL to pick one with a free state machine and program space. */
+    uint8_t data_pin; /**< Sensor data pin. */
+    bool pull_up; /**< Whether to enable the internal pull-up. */
+    /**
+     * Whether to claim a DMA channel. Without DMA, the frame is collected in
+     * the joined RX FIFO and read on completion; completion callbacks then
+     * poll the FIFO from the timeout alarm instead of taking a DMA interrupt.
+     * Pulse capture and hardware checksum require DMA.
+     */
+    bool use_dma;
+    /**
+     * Whether blocking calls sleep instead of spinning. The core waits for
+     * events (WFE) until the DMA completion interrupt or the next timeout
+     * check, so it's mostly idle while the frame arrives. Without DMA, it
+     * wakes up periodically to poll the RX FIFO.
+     */
+    bool low_power;
+    /**
+     * State machine clock rate in Hz, or 0 for DHT_PIO_SM_CLOCK_FREQUENCY.
+     * Faster clocks (e.g. 4-10MHz) measure pulses with finer resolution, and
+     * keep divider rounding error small at unusual system clocks. Must not
+     * exceed clk_sys.
+     */
+    uint32_t pio_clock_frequency;
+    /**
+     * Whether to load the compact PIO program, which takes 10 instructions
+     * instead of 18 and leaves more room for other PIO programs. It samples
+     * each bit once instead of timing the whole pulse, but produces the same
+     * bytes.
+     */
+    bool compact_program;
+} dht_config_t;
 
 /**
  * \brief DHT sensor.
  */
-typedef struct dht_t {
+struct dht_t {
     PIO pio;
     uint8_t model;
     uint8_t pio_program_offset;
@@ -40,32 +143,92 @@ typedef struct dht_t {
     uint8_t dma_chan;
     uint8_t data_pin;
     uint8_t data[5];
+    uint8_t *frame;
+    bool use_dma;
+    bool low_power;
+    bool compact_program;
+    bool hw_checksum;
+    uint32_t *pulses;
+    uint32_t pio_clock_frequency;
+    uint32_t actual_pio_clock_frequency;
+    uint32_t clkdiv_x256;
+    uint32_t start_signal_loops;
+    uint32_t long_pulse_loops;
     uint32_t start_time;
-} dht_t;
+    dht_callback_t callback;
+    dht_callback_x10_t callback_x10;
+    void *callback_user_data;
+    volatile alarm_id_t timeout_alarm;
+    volatile bool completion_pending;
+    dht_history_t *history;
+    dht_filter_t *filter;
+    volatile uint32_t cache_seq;
+    int16_t cache_humidity_x10;
+    int16_t cache_temperature_c_x10;
+    uint64_t cache_time_us;
+#if DHT_STATS_ENABLED
+    dht_stats_t stats;
+    bool last_failed;
+#endif
+};
 
 /**
- * \brief Measurement result.
+ * \brief Measurement result and values.
  */
-typedef enum dht_result_t {
-    DHT_RESULT_OK, /**< No error.*/
-    DHT_RESULT_TIMEOUT, /**< DHT sensor not reponding. */
-    DHT_RESULT_BAD_CHECKSUM, /**< Sensor data doesn't match checksum. */
-} dht_result_t;
+typedef struct dht_reading_t {
+    dht_result_t result;
+    float humidity; /**< Relative humidity. Only valid if result is DHT_RESULT_OK. */
+    float temperature_c; /**< Degrees Celsius. Only valid if result is DHT_RESULT_OK. */
+} dht_reading_t;
+
+/**
+ * \brief Group of DHT sensors measured in parallel.
+ */
+typedef struct dht_group_t {
+    dht_t *sensors;
+    uint count;
+} dht_group_t;
 
 /**
  * \brief Initialize DHT sensor.
  * 
  * The library claims one state machine from the given PIO instance, and one DMA
- * channel to communicate with the sensor.
+ * channel to communicate with the sensor (see dht_init_with_config() to do
+ * without DMA). The PIO program is loaded once per PIO
+ * instance and shared by all sensors using it, so a PIO block can serve up to
+ * four sensors.
  * 
  * \param dht DHT sensor.
  * \param model DHT sensor model.
- * \param pio PIO block to use (pio0 or pio1).
+ * \param pio PIO block to use (pio0, pio1, or pio2 on RP2350).
  * \param data_pin Sensor data pin.
  * \param pull_up Whether to enable the internal pull-up.
  */
 void dht_init(dht_t *dht, dht_model_t model, PIO pio, uint8_t data_pin, bool pull_up);
 
+/**
+ * \brief Get the default sensor configuration.
+ *
+ * The internal pull-up is enabled, a DMA channel is used, and blocking calls
+ * spin while waiting.
+ *
+ * \param model DHT sensor model.
+ * \param pio PIO block to use (pio0, pio1, or pio2 on RP2350).
+ * \param data_pin Sensor data pin.
+ * \return Default configuration.
+ */
+dht_config_t dht_get_default_config(dht_model_t model, PIO pio, uint8_t data_pin);
+
+/**
+ * \brief Initialize DHT sensor with the given configuration.
+ *
+ * Same as dht_init(), with the additional options of dht_config_t.
+ *
+ * \param dht DHT sensor.
+ * \param config Sensor configuration.
+ */
+void dht_init_with_config(dht_t *dht, const dht_config_t *config);
+
 /**
  * \brief Deinitialize DHT sensor.
  *
@@ -73,6 +236,19 @@ void dht_init(dht_t *dht, dht_model_t model, PIO pio, uint8_t data_pin, bool pul
  */
 void dht_deinit(dht_t *dht);
 
+/**
+ * \brief Update the state machine timing after changing clk_sys.
+ *
+ * The clock divider is derived from clk_sys when the sensor is initialized,
+ * and loop counts are computed from the resulting frequency. Call this after
+ * switching system clocks (e.g. underclocking, overclocking, or returning from
+ * a low-power state), so that timing stays accurate. Must not be called while
+ * a measurement is in progress.
+ *
+ * \param dht DHT sensor.
+ */
+void dht_sync_clock(dht_t *dht);
+
 /**
  * \brief Start asynchronous measurement.
  *
@@ -86,6 +262,18 @@ void dht_deinit(dht_t *dht);
  */
 void dht_start_measurement(dht_t *dht);
 
+/**
+ * \brief Abort the measurement in progress, if any, without waiting for it.
+ *
+ * The state machine and DMA transfer are stopped, and the line is released.
+ * In callback mode, the callback isn't invoked for the aborted measurement,
+ * unless it was already being delivered. Statistics, cache and history are
+ * left unchanged.
+ *
+ * \param dht DHT sensor.
+ */
+void dht_cancel_measurement(dht_t *dht);
+
 /**
  * \brief Wait for measurement to complete and get the result.
  *
@@ -96,6 +284,318 @@ void dht_start_measurement(dht_t *dht);
  */
 dht_result_t dht_finish_measurement_blocking(dht_t *dht, float *humidity, float *temperature_c);
 
+/**
+ * \brief Wait for measurement to complete and get the result in fixed-point.
+ *
+ * Same as dht_finish_measurement_blocking(), but values are returned as integer
+ * tenths, avoiding floating point math.
+ *
+ * \param dht DHT sensor.
+ * \param[out] humidity_x10 Relative humidity, in tenths of a percent. May be NULL.
+ * \param[out] temperature_c_x10 Tenths of a degree Celsius. May be NULL.
+ * \return Result status.
+ */
+dht_result_t dht_finish_measurement_blocking_x10(dht_t *dht, int16_t *humidity_x10, int16_t *temperature_c_x10);
+
+/**
+ * \brief Get the measurement result if available, without blocking.
+ *
+ * Returns DHT_RESULT_IN_PROGRESS while the measurement is still running. Any
+ * other result completes the measurement, same as
+ * dht_finish_measurement_blocking().
+ *
+ * \param dht DHT sensor.
+ * \param[out] humidity Relative humidity. May be NULL.
+ * \param[out] temperature_c Degrees Celsius. May be NULL.
+ * \return Result status.
+ */
+dht_result_t dht_try_finish_measurement(dht_t *dht, float *humidity, float *temperature_c);
+
+/**
+ * \brief Get the measurement result in fixed-point if available, without blocking.
+ *
+ * \see dht_try_finish_measurement()
+ *
+ * \param dht DHT sensor.
+ * \param[out] humidity_x10 Relative humidity, in tenths of a percent. May be NULL.
+ * \param[out] temperature_c_x10 Tenths of a degree Celsius. May be NULL.
+ * \return Result status.
+ */
+dht_result_t dht_try_finish_measurement_x10(dht_t *dht, int16_t *humidity_x10, int16_t *temperature_c_x10);
+
+/**
+ * \brief Get the raw sensor frame if available, without blocking.
+ *
+ * Like dht_try_finish_measurement(), but the frame is only checked against its
+ * checksum and not decoded, for callers that decode it themselves (see
+ * dht.hpp). Since the values are unknown to the library, the reading is not
+ * cached or added to the history.
+ *
+ * \param dht DHT sensor.
+ * \param[out] frame The 5 bytes sent by the sensor. Only valid if the result is DHT_RESULT_OK.
+ * \return Result status.
+ */
+dht_result_t dht_try_finish_measurement_raw(dht_t *dht, uint8_t frame[5]);
+
+/**
+ * \brief Detect the sensor model, and use it for later measurements.
+ *
+ * Blocks for up to two measurements. The sensor is first woken with the short
+ * DHT21/DHT22 start signal, and then, if there's no sensible answer, with the
+ * long DHT11/DHT12 one. The model is told by which start signal works and by
+ * which encoding the frame makes sense in (see dht_frame_is_plausible()).
+ * DHT21 and DHT22 share timing and encoding, and are reported as DHT22.
+ * DHT11 and DHT12 frames can't be told apart either, so the configured model
+ * is kept if it's one of them, and DHT12 is reported otherwise (see
+ * dht_resolve_dht1x_model()).
+ *
+ * On success, the detected model replaces the one given at initialization, so
+ * later measurements use the shortest valid start signal and the right
+ * decoder. Otherwise the model is left unchanged.
+ *
+ * Not available in callback mode, or when capturing pulses.
+ *
+ * \param dht DHT sensor.
+ * \param[out] model Detected model. May be NULL.
+ * \return DHT_RESULT_OK, the failure of the last probe, or
+ * DHT_RESULT_BAD_CHECKSUM if no model matches the frame.
+ */
+dht_result_t dht_detect_model(dht_t *dht, dht_model_t *model);
+
+/**
+ * \brief Receive frames directly into a caller-provided buffer.
+ *
+ * The DMA channel (or the FIFO reads, without DMA) targets the buffer instead
+ * of dht_t, so raw frames of several sensors can be kept in one contiguous
+ * array. The buffer holds the frame of the last measurement, and is only
+ * valid once it completed with DHT_RESULT_OK. Results are still decoded,
+ * cached and delivered as usual.
+ *
+ * Not available when capturing pulses, since the 40 widths don't fit.
+ *
+ * \param dht DHT sensor.
+ * \param frame Buffer, or NULL to go back to the internal one. Must outlive
+ * the sensor, or be reset first.
+ */
+void dht_set_frame_buffer(dht_t *dht, dht_frame_t *frame);
+
+/**
+ * \brief Deliver measurement results to a callback.
+ *
+ * When a callback is set, each measurement completes in the background: the
+ * callback is invoked from the DMA completion interrupt, or from a timer alarm
+ * if the sensor doesn't respond in time. The CPU doesn't need to poll, and may
+ * sleep with __wfi() in the meantime. Don't call dht_finish_measurement_blocking()
+ * or dht_try_finish_measurement() in this mode.
+ *
+ * The library installs a shared handler on DMA_IRQ_0 (override with
+ * DHT_DMA_IRQ_INDEX), and uses the default alarm pool for timeouts.
+ *
+ * Must not be called while a measurement is in progress.
+ *
+ * \param dht DHT sensor.
+ * \param callback Completion callback, or NULL to go back to polling.
+ * \param user_data User data passed to callback.
+ */
+void dht_set_callback(dht_t *dht, dht_callback_t callback, void *user_data);
+
+/**
+ * \brief Deliver measurement results to a fixed-point callback.
+ *
+ * Same as dht_set_callback(), but values are passed as integer tenths, which
+ * keeps floating point out of the completion interrupt. Replaces any callback
+ * set by dht_set_callback().
+ *
+ * \param dht DHT sensor.
+ * \param callback Completion callback, or NULL to go back to polling.
+ * \param user_data User data passed to callback.
+ */
+void dht_set_callback_x10(dht_t *dht, dht_callback_x10_t callback, void *user_data);
+
+/**
+ * \brief Get the last good reading, refreshing it in the background when stale.
+ *
+ * Every successful measurement is cached together with its time_us_64()
+ * timestamp. If the cached reading is at most max_age_us old, it is returned
+ * immediately. Otherwise a new measurement is started (once the minimum interval
+ * since the previous one has passed) and DHT_RESULT_IN_PROGRESS is returned
+ * until it completes; call again to collect the fresh reading.
+ *
+ * In callback mode, measurements are left to the callback owner (e.g.
+ * dht_scheduler_t or dht_async_t). The cache is only read, and
+ * DHT_RESULT_IN_PROGRESS is returned while it's stale.
+ *
+ * \param dht DHT sensor.
+ * \param max_age_us Maximum age of the cached reading, in microseconds.
+ * \param[out] humidity Relative humidity. May be NULL.
+ * \param[out] temperature_c Degrees Celsius. May be NULL.
+ * \return DHT_RESULT_OK with a fresh enough reading, DHT_RESULT_IN_PROGRESS while
+ * refreshing, or the error status of a failed refresh.
+ */
+dht_result_t dht_get_cached(dht_t *dht, uint64_t max_age_us, float *humidity, float *temperature_c);
+
+/**
+ * \brief Get the last good reading in fixed-point.
+ *
+ * \see dht_get_cached()
+ *
+ * \param dht DHT sensor.
+ * \param max_age_us Maximum age of the cached reading, in microseconds.
+ * \param[out] humidity_x10 Relative humidity, in tenths of a percent. May be NULL.
+ * \param[out] temperature_c_x10 Tenths of a degree Celsius. May be NULL.
+ * \return Result status.
+ */
+dht_result_t dht_get_cached_x10(dht_t *dht, uint64_t max_age_us, int16_t *humidity_x10, int16_t *temperature_c_x10);
+
+/**
+ * \brief Verify the checksum with the DMA sniffer.
+ *
+ * The sniffer accumulates the frame bytes while they are transferred, so the
+ * frame is validated immediately on completion without summing it in software.
+ * There is a single sniffer, so only one sensor can use it at a time. Other
+ * users of the sniffer must not be active while this sensor is measuring.
+ *
+ * Not available with pulse capture. Must not be called while a measurement is
+ * in progress.
+ *
+ * \param dht DHT sensor.
+ * \param enabled Whether to use the sniffer.
+ * \return False if the sniffer is already used by another sensor.
+ */
+bool dht_enable_hw_checksum(dht_t *dht, bool enabled);
+
+/**
+ * \brief Capture raw pulse widths instead of bits.
+ *
+ * In this mode the state machine measures the high pulse of every data bit
+ * and DMA stores it in the given buffer. Once the measurement completes the
+ * buffer holds the widths in microseconds, and bits are decoded with
+ * dht_decode_pulses(), which adapts the threshold to the actual pulse widths.
+ * This tolerates timing drift from long cables or out-of-spec sensors, and
+ * helps diagnose them.
+ *
+ * Switches to a different PIO program, reloaded if no other sensor on this
+ * PIO block uses it. Must not be called while a measurement is in progress.
+ *
+ * \param dht DHT sensor.
+ * \param pulse_widths_us Buffer for DHT_PULSE_COUNT widths, or NULL to go back
+ * to the regular mode. Must stay valid while capture is enabled.
+ */
+void dht_enable_pulse_capture(dht_t *dht, uint32_t *pulse_widths_us);
+
+/**
+ * \brief Record every measurement in a history ring.
+ *
+ * Each completed measurement, successful or not, is appended to the history
+ * (see dht_history.h) from whatever context completes it. Must not be called
+ * while a measurement is in progress.
+ *
+ * \param dht DHT sensor.
+ * \param history Initialized history, or NULL to stop recording.
+ */
+void dht_set_history(dht_t *dht, dht_history_t *history);
+
+/**
+ * \brief Filter cached readings.
+ *
+ * Each successful measurement is passed through the filter (see
+ * dht_filter.h), and the filtered values are what dht_get_cached() returns.
+ * Readings rejected as outliers leave the cache unchanged. Values returned
+ * directly by the finish functions and callbacks, and the history, are not
+ * filtered. Must not be called while a measurement is in progress.
+ *
+ * \param dht DHT sensor.
+ * \param filter Initialized filter, or NULL to cache raw readings.
+ */
+void dht_set_filter(dht_t *dht, dht_filter_t *filter);
+
+#if DHT_STATS_ENABLED
+/**
+ * \brief Get measurement statistics.
+ *
+ * Only available when DHT_STATS_ENABLED is set.
+ *
+ * \param dht DHT sensor.
+ * \param[out] stats Statistics collected since dht_init() or the last reset.
+ */
+void dht_get_stats(const dht_t *dht, dht_stats_t *stats);
+
+/**
+ * \brief Reset measurement statistics.
+ *
+ * Only available when DHT_STATS_ENABLED is set.
+ *
+ * \param dht DHT sensor.
+ */
+void dht_reset_stats(dht_t *dht);
+#endif
+
+/**
+ * \brief Initialize sensor group.
+ *
+ * The group refers to an array of sensors that have already been initialized
+ * with dht_init().
+ *
+ * \param group Sensor group.
+ * \param sensors Array of sensors. Must outlive the group.
+ * \param count Number of sensors in the array.
+ */
+void dht_group_init(dht_group_t *group, dht_t *sensors, uint count);
+
+/**
+ * \brief Start asynchronous measurement on all sensors in the group.
+ *
+ * State machines sharing a PIO block are enabled together, so the whole group
+ * completes in about the time of a single measurement.
+ *
+ * \param group Sensor group.
+ */
+void dht_group_start_measurement(dht_group_t *group);
+
+/**
+ * \brief Wait for all measurements in the group to complete.
+ *
+ * \param group Sensor group.
+ * \param[out] readings Array receiving one reading per sensor.
+ */
+void dht_group_finish_measurement_blocking(dht_group_t *group, dht_reading_t *readings);
+
+/**
+ * \brief Point every sensor in the group at a shared frame array.
+ *
+ * Same as calling dht_set_frame_buffer() with consecutive elements, so one
+ * group measurement leaves all raw frames side by side.
+ *
+ * \param group Sensor group.
+ * \param frames Array of one frame per sensor, or NULL to go back to the
+ * internal buffers.
+ */
+void dht_group_set_frame_buffers(dht_group_t *group, dht_frame_t *frames);
+
+/**
+ * \brief Wait for all measurements in the group to complete, without decoding.
+ *
+ * Like dht_try_finish_measurement_raw(), frames are only checked against
+ * their checksum, and aren't cached or added to the history. Frames are left
+ * in the group's frame buffers (see dht_group_set_frame_buffers()), or can be
+ * read with dht_get_frame() otherwise.
+ *
+ * \param group Sensor group.
+ * \param[out] results Array receiving one result per sensor.
+ */
+void dht_group_finish_measurement_raw_blocking(dht_group_t *group, dht_result_t *results);
+
+/**
+ * \brief Get the frame received by the last measurement.
+ *
+ * \param dht DHT sensor.
+ * \return The 5 bytes sent by the sensor. Only valid if the last measurement
+ * completed with DHT_RESULT_OK.
+ */
+static inline const uint8_t *dht_get_frame(const dht_t *dht) {
+    return dht->frame;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_HPP_
+#define _DHT_HPP_
+
+#include <dht.h>
+
+/** \file dht.hpp
+ *
+ * \brief C++ wrapper specialized per sensor model at compile time.
+ *
+ * Model timing and frame decoding are constexpr, so readings are decoded
+ * without model dispatch or floating point. State machine timing is still set
+ * up at runtime by dht_init_with_config(), since it depends on clk_sys. The
+ * wrapper owns the underlying dht_t: it is initialized on construction and
+ * released on destruction.
+ */
+
+namespace dht {
+
+/**
+ * \brief Compile-time properties of a sensor model.
+ */
+template <dht_model_t Model>
+struct ModelTraits {
+    static_assert(Model == DHT11 || Model == DHT12 || Model == DHT21 || Model == DHT22, "invalid model");
+
+    /** \brief Duration of the start signal. */
+    static constexpr uint32_t start_pulse_duration_us = DHT_START_PULSE_DURATION_US(Model);
+
+    /** \brief Minimum interval between measurements. */
+    static constexpr uint32_t min_interval_us = DHT_MIN_INTERVAL_US(Model);
+
+    /** \brief High pulses at least this long encode 1 bits. */
+    static constexpr uint32_t long_pulse_threshold_us = DHT_LONG_PULSE_THRESHOLD_US;
+
+    /** \brief Relative humidity, in tenths of a percent. */
+    static constexpr int16_t decode_humidity_x10(uint8_t b0, uint8_t b1) {
+        if constexpr (Model == DHT11 || Model == DHT12) {
+            return b0 * 10 + b1;
+        } else {
+            return static_cast<int16_t>((b0 << 8) + b1);
+        }
+    }
+
+    /** \brief Tenths of a degree Celsius. */
+    static constexpr int16_t decode_temperature_x10(uint8_t b0, uint8_t b1) {
+        if constexpr (Model == DHT11) {
+            // below-zero temperature not supported
+            return (b1 & 0x80) ? 0 : b0 * 10 + b1;
+        } else if constexpr (Model == DHT12) {
+            int16_t temperature = b0 * 10 + (b1 & 0x7F);
+            return (b1 & 0x80) ? -temperature : temperature;
+        } else {
+            int16_t temperature = ((b0 & 0x7F) << 8) + b1;
+            return (b0 & 0x80) ? -temperature : temperature;
+        }
+    }
+};
+
+/**
+ * \brief Measurement result and fixed-point values.
+ */
+struct Reading {
+    dht_result_t result = DHT_RESULT_IN_PROGRESS; /**< Result status. */
+    int16_t humidity_x10 = 0; /**< Relative humidity, in tenths of a percent. Only valid if ok(). */
+    int16_t temperature_c_x10 = 0; /**< Tenths of a degree Celsius. Only valid if ok(). */
+
+    /** \brief Whether the measurement succeeded. */
+    constexpr bool ok() const { return result == DHT_RESULT_OK; }
+
+    /** \brief Whether the measurement is still running. */
+    constexpr bool in_progress() const { return result == DHT_RESULT_IN_PROGRESS; }
+};
+
+/**
+ * \brief DHT sensor of a fixed model.
+ *
+ * Not copyable or movable: the library keeps pointers to the underlying
+ * dht_t while measurements are in progress.
+ */
+template <dht_model_t Model>
+class Sensor {
+public:
+    using Traits = ModelTraits<Model>;
+
+    /**
+     * \brief Initialize sensor.
+     *
+     * \param pio PIO block to use, or NULL to pick one automatically.
+     * \param data_pin Sensor data pin.
+     * \param pull_up Whether to enable the internal pull-up.
+     * \param use_dma Whether to claim a DMA channel (see dht_config_t).
+     */
+    Sensor(PIO pio, uint8_t data_pin, bool pull_up = true, bool use_dma = true) {
+        dht_config_t config = dht_get_default_config(Model, pio, data_pin);
+        config.pull_up = pull_up;
+        config.use_dma = use_dma;
+        dht_init_with_config(&dht_, &config);
+    }
+
+    ~Sensor() {
+        dht_deinit(&dht_);
+    }
+
+    Sensor(const Sensor &) = delete;
+    Sensor &operator=(const Sensor &) = delete;
+
+    /** \brief Start asynchronous measurement. See dht_start_measurement(). */
+    void start() {
+        dht_start_measurement(&dht_);
+    }
+
+    /**
+     * \brief Get the measurement result if available, without blocking.
+     *
+     * The reading is in progress until the measurement completes.
+     */
+    Reading try_finish() {
+        uint8_t frame[5];
+        dht_result_t result = dht_try_finish_measurement_raw(&dht_, frame);
+        return (result == DHT_RESULT_OK) ? decode(frame) : Reading{ result };
+    }
+
+    /** \brief Wait for the measurement to complete. */
+    Reading finish_blocking() {
+        Reading reading;
+        while ((reading = try_finish()).in_progress()) {
+            tight_loop_contents();
+        }
+        return reading;
+    }
+
+    /** \brief Decode a frame whose checksum has already been verified. */
+    static constexpr Reading decode(const uint8_t frame[5]) {
+        return Reading{
+            DHT_RESULT_OK,
+            Traits::decode_humidity_x10(frame[0], frame[1]),
+            Traits::decode_temperature_x10(frame[2], frame[3]),
+        };
+    }
+
+    /** \brief Underlying sensor, for the rest of the C API. */
+    dht_t *get() {
+        return &dht_;
+    }
+
+private:
+    dht_t dht_;
+};
+
+} // namespace dht
+
+#endif // _DHT_HPP_
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_ASYNC_H_
+#define _DHT_ASYNC_H_
+
+#include <dht.h>
+#include <pico/async_context.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file dht_async.h
+ *
+ * \brief Measurements driven by an async_context.
+ *
+ * Measurements are started from a context worker and complete in the
+ * background (see dht_set_callback()). Results are then handed back to the
+ * context, so the user callback runs alongside other context work, such as
+ * the CYW43 driver and lwIP, without ever blocking it.
+ */
+
+/**
+ * \brief Async context binding of a DHT sensor.
+ */
+typedef struct dht_async_t {
+    async_context_t *context;
+    dht_t *dht;
+    dht_callback_t callback;
+    void *user_data;
+    uint32_t period_us;
+    async_when_pending_worker_t completion_worker;
+    async_at_time_worker_t start_worker;
+    volatile dht_result_t result;
+    volatile int16_t humidity_x10;
+    volatile int16_t temperature_c_x10;
+} dht_async_t;
+
+/**
+ * \brief Bind sensor to async context.
+ *
+ * Takes over the sensor's completion callback. Must be called with the context
+ * lock held, or from context work.
+ *
+ * \param async Async binding.
+ * \param context Async context.
+ * \param dht Initialized DHT sensor, with no measurement in progress.
+ * \param callback Result callback, invoked from the context. May be NULL.
+ * \param user_data User data passed to callback.
+ */
+void dht_async_init(dht_async_t *async, async_context_t *context, dht_t *dht, dht_callback_t callback, void *user_data);
+
+/**
+ * \brief Unbind sensor from async context.
+ *
+ * Stops periodic sampling, and aborts the measurement in progress, if any
+ * (see dht_cancel_measurement()). Its result is discarded. Doesn't block.
+ * Must be called with the context lock held, or from context work.
+ *
+ * \param async Async binding.
+ */
+void dht_async_deinit(dht_async_t *async);
+
+/**
+ * \brief Start a single measurement.
+ *
+ * Returns immediately. Must be called with the context lock held, or from
+ * context work.
+ *
+ * \param async Async binding.
+ */
+void dht_async_start_measurement(dht_async_t *async);
+
+/**
+ * \brief Start periodic sampling.
+ *
+ * Must be called with the context lock held, or from context work.
+ *
+ * \param async Async binding.
+ * \param period_us Sampling period. Never shorter than dht_get_min_interval_us()
+ * allows for the sensor model.
+ */
+void dht_async_start_periodic(dht_async_t *async, uint32_t period_us);
+
+/**
+ * \brief Stop periodic sampling.
+ *
+ * A measurement already in progress still completes and is reported. Must be
+ * called with the context lock held, or from context work.
+ *
+ * \param async Async binding.
+ */
+void dht_async_stop_periodic(dht_async_t *async);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _DHT_ASYNC_H_
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_DECODE_H_
+#define _DHT_DECODE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file dht_decode.h
+ *
+ * \brief Sensor frame decoding.
+ *
+ * Frame decoding doesn't depend on the Pico SDK, so it can also be built for
+ * the host (see host/).
+ */
+
+/** \brief Number of data bits sent by the sensor. */
+#define DHT_PULSE_COUNT 40
+
+/** \brief Nominal boundary between short (0) and long (1) data pulses. */
+#define DHT_LONG_PULSE_THRESHOLD_US 50
+
+/** \brief Start signal duration, as a constant expression. See dht_get_start_pulse_duration_us(). */
+#define DHT_START_PULSE_DURATION_US(model) (((model) == DHT21 || (model) == DHT22) ? 1000 : 18000)
+
+/** \brief Minimum interval between measurements, as a constant expression. See dht_get_min_interval_us(). */
+#define DHT_MIN_INTERVAL_US(model) (((model) == DHT11) ? 1000000 : 2000000)
+
+/**
+ * \brief DHT sensor model.
+ */
+typedef enum dht_model_t {
+    DHT11,
+    DHT12,
+    DHT21,
+    DHT22,
+} dht_model_t;
+
+/**
+ * \brief Measurement result.
+ */
+typedef enum dht_result_t {
+    DHT_RESULT_OK, /**< No error.*/
+    DHT_RESULT_TIMEOUT, /**< DHT sensor not reponding. */
+    DHT_RESULT_BAD_CHECKSUM, /**< Sensor data doesn't match checksum. */
+    DHT_RESULT_IN_PROGRESS, /**< Measurement not finished yet. */
+    DHT_RESULT_NO_RESPONSE, /**< DHT sensor didn't acknowledge the start signal. */
+    DHT_RESULT_STALLED, /**< DHT sensor stopped sending in the middle of a frame. */
+} dht_result_t;
+
+/**
+ * \brief Raw sensor frame, padded to 8 bytes.
+ *
+ * Arrays of frames have a fixed, word-aligned stride, so they can be filled
+ * directly by DMA and decoded as a batch.
+ */
+typedef struct dht_frame_t {
+    uint8_t bytes[5]; /**< Humidity, temperature and checksum bytes, as sent by the sensor. */
+    uint8_t reserved[3];
+} __attribute__((aligned(4))) dht_frame_t;
+
+/**
+ * \brief Decoded values in fixed-point.
+ */
+typedef struct dht_values_x10_t {
+    int16_t humidity_x10; /**< Relative humidity, in tenths of a percent. */
+    int16_t temperature_c_x10; /**< Tenths of a degree Celsius. */
+} dht_values_x10_t;
+
+/** \brief Number of 32-bit words in the invalid frame mask of a batch. */
+#define DHT_BATCH_MASK_WORDS(count) (((count) + 31) / 32)
+
+/**
+ * \brief Get the start signal duration.
+ *
+ * \param model DHT sensor model.
+ * \return Duration the data line is held low to wake the sensor, in microseconds.
+ */
+uint32_t dht_get_start_pulse_duration_us(dht_model_t model);
+
+/**
+ * \brief Get the minimum interval between measurements.
+ *
+ * \param model DHT sensor model.
+ * \return Minimum interval between measurement starts, in microseconds.
+ */
+uint32_t dht_get_min_interval_us(dht_model_t model);
+
+/**
+ * \brief Decode humidity bytes.
+ *
+ * \param model DHT sensor model.
+ * \param b0 First humidity byte.
+ * \param b1 Second humidity byte.
+ * \return Relative humidity, in tenths of a percent.
+ */
+int16_t dht_decode_humidity_x10(dht_model_t model, uint8_t b0, uint8_t b1);
+
+/**
+ * \brief Decode temperature bytes.
+ *
+ * \param model DHT sensor model.
+ * \param b0 First temperature byte.
+ * \param b1 Second temperature byte.
+ * \return Tenths of a degree Celsius.
+ */
+int16_t dht_decode_temperature_x10(dht_model_t model, uint8_t b0, uint8_t b1);
+
+/**
+ * \brief Decode bits from captured pulse widths.
+ *
+ * The threshold separating short (0) and long (1) pulses is picked from the
+ * distribution of widths. If all pulses have about the same width, the
+ * standard 50us threshold is used.
+ *
+ * \param pulse_widths_us High pulse widths of the DHT_PULSE_COUNT data bits.
+ * \param[out] frame The decoded 5 bytes.
+ * \return Threshold used, in microseconds.
+ */
+uint32_t dht_decode_pulses(const uint32_t pulse_widths_us[DHT_PULSE_COUNT], uint8_t frame[5]);
+
+/**
+ * \brief Verify and decode a raw sensor frame.
+ *
+ * \param model DHT sensor model.
+ * \param frame The 5 bytes sent by the sensor.
+ * \param[out] humidity_x10 Relative humidity, in tenths of a percent.
+ * \param[out] temperature_c_x10 Tenths of a degree Celsius.
+ * \return DHT_RESULT_OK, or DHT_RESULT_BAD_CHECKSUM if the frame is corrupted.
+ */
+dht_result_t dht_decode_frame_x10(dht_model_t model, const uint8_t frame[5], int16_t *humidity_x10, int16_t *temperature_c_x10);
+
+/**
+ * \brief Check whether a frame makes sense for the given model.
+ *
+ * Values must be within the sensor's range, and DHT11/DHT12 decimal bytes
+ * must be single digits. Frames from different model families rarely pass
+ * each other's check, which is what model detection relies on.
+ *
+ * \param model DHT sensor model.
+ * \param frame The 5 bytes sent by the sensor. The checksum isn't verified.
+ * \return True if the values are plausible.
+ */
+bool dht_frame_is_plausible(dht_model_t model, const uint8_t frame[5]);
+
+/**
+ * \brief Pick the model of a sensor that answered with a DHT11/DHT12 frame.
+ *
+ * The two share timing and frame layout, and a frame plausible for one is
+ * plausible for the other, so the frame can't tell them apart. The configured
+ * model is kept if it belongs to the family. Otherwise DHT12 is chosen, which
+ * keeps the temperature sign and waits the longer minimum interval.
+ *
+ * \param configured_model Model given at initialization.
+ * \return DHT11 or DHT12.
+ */
+dht_model_t dht_resolve_dht1x_model(dht_model_t configured_model);
+
+/**
+ * \brief Verify and decode many raw frames of the same model.
+ *
+ * Same results as dht_decode_frame_x10() on each frame, but the model is
+ * resolved once, and every frame goes through the same branch-free steps on
+ * its 4 payload bytes loaded as one word.
+ *
+ * \param model DHT sensor model.
+ * \param frames Frames to decode.
+ * \param count Number of frames.
+ * \param[out] values Array receiving one value per frame. Zero where the frame is invalid.
+ * \param[out] invalid_mask Array of DHT_BATCH_MASK_WORDS(count) words, where bit
+ * (i % 32) of word (i / 32) is set if frame i fails its checksum. May be NULL.
+ * \return Number of invalid frames.
+ */
+uint32_t dht_decode_batch(dht_model_t model, const dht_frame_t *frames, uint32_t count, dht_values_x10_t *values, uint32_t *invalid_mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _DHT_DECODE_H_
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_FILTER_H_
+#define _DHT_FILTER_H_
+
+#include <dht_decode.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file dht_filter.h
+ *
+ * \brief Incremental filtering of readings.
+ *
+ * Readings pass through three optional stages, in fixed memory:
+ * - rate-of-change outlier rejection against the last accepted reading,
+ * - a median over the last accepted readings,
+ * - an integer exponential moving average of the median.
+ *
+ * Attached to a sensor with dht_set_filter(), the filter runs on every
+ * successful measurement and its output is what dht_get_cached() returns.
+ */
+
+/** \brief Largest median window. */
+#define DHT_FILTER_MAX_WINDOW 9
+
+/**
+ * \brief Filter configuration.
+ */
+typedef struct dht_filter_config_t {
+    uint8_t median_window; /**< Median window, up to DHT_FILTER_MAX_WINDOW. 0 or 1 disables the median. */
+    uint8_t ema_shift; /**< EMA weight of a new value is 1 / 2^ema_shift. 0 disables the EMA. */
+    uint16_t max_humidity_step_x10; /**< Largest humidity change between readings. 0 disables the check. */
+    uint16_t max_temperature_step_x10; /**< Largest temperature change between readings. 0 disables the check. */
+    /**
+     * After this many consecutive rejections, the next reading is accepted
+     * and restarts the filter, so a genuine step change isn't rejected forever.
+     */
+    uint8_t max_rejections;
+} dht_filter_config_t;
+
+/**
+ * \brief Filter state.
+ */
+typedef struct dht_filter_t {
+    dht_filter_config_t config;
+    uint8_t count;
+    uint8_t next;
+    uint8_t rejections;
+    int16_t last_humidity_x10;
+    int16_t last_temperature_c_x10;
+    int16_t humidity_window[DHT_FILTER_MAX_WINDOW];
+    int16_t temperature_window[DHT_FILTER_MAX_WINDOW];
+    int32_t humidity_ema; // scaled by 2^ema_shift
+    int32_t temperature_ema;
+} dht_filter_t;
+
+/**
+ * \brief Get the default filter configuration.
+ *
+ * Median of 3, EMA weight 1/4, and outlier rejection of steps over 10%
+ * humidity or 5 degrees Celsius, for up to 3 readings in a row.
+ *
+ * \return Default configuration.
+ */
+dht_filter_config_t dht_filter_get_default_config(void);
+
+/**
+ * \brief Initialize filter.
+ *
+ * \param filter Filter.
+ * \param config Filter configuration.
+ */
+void dht_filter_init(dht_filter_t *filter, const dht_filter_config_t *config);
+
+/**
+ * \brief Forget all previous readings.
+ *
+ * \param filter Filter.
+ */
+void dht_filter_reset(dht_filter_t *filter);
+
+/**
+ * \brief Filter a new reading.
+ *
+ * \param filter Filter.
+ * \param[in,out] humidity_x10 Relative humidity, in tenths of a percent. Replaced by the filtered value.
+ * \param[in,out] temperature_c_x10 Tenths of a degree Celsius. Replaced by the filtered value.
+ * \return False if the reading was rejected as an outlier; the values are left unchanged.
+ */
+bool dht_filter_update(dht_filter_t *filter, int16_t *humidity_x10, int16_t *temperature_c_x10);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _DHT_FILTER_H_
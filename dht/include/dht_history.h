@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_HISTORY_H_
+#define _DHT_HISTORY_H_
+
+#include <dht.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file dht_history.h
+ *
+ * \brief Fixed-capacity history of timestamped readings.
+ *
+ * The history is a ring that overwrites its oldest records. It has a single
+ * writer, typically the context completing measurements (an interrupt, or core
+ * 1), and any number of readers. Readers never block the writer and don't need
+ * to disable interrupts: a record overwritten while being read is detected and
+ * read again.
+ */
+
+/** \brief Number of records kept. Must be a power of two. */
+#ifndef DHT_HISTORY_CAPACITY
+#define DHT_HISTORY_CAPACITY 32
+#endif
+
+/**
+ * \brief History record.
+ */
+typedef struct dht_record_t {
+    uint64_t time_us; /**< Completion time, from time_us_64(). */
+    int16_t temperature_c_x10; /**< Tenths of a degree Celsius. Zero unless result is DHT_RESULT_OK. */
+    uint16_t humidity_x10; /**< Relative humidity, in tenths of a percent. Zero unless result is DHT_RESULT_OK. */
+    uint8_t result; /**< Result status. */
+} dht_record_t;
+
+/**
+ * \brief History ring.
+ */
+struct dht_history_t {
+    volatile uint32_t write_count;
+    dht_record_t records[DHT_HISTORY_CAPACITY];
+};
+
+/**
+ * \brief Initialize history.
+ *
+ * \param history History.
+ */
+void dht_history_init(dht_history_t *history);
+
+/**
+ * \brief Append record, overwriting the oldest one if full.
+ *
+ * Must only be called by the single writer.
+ *
+ * \param history History.
+ * \param record Record to append.
+ */
+void dht_history_push(dht_history_t *history, const dht_record_t *record);
+
+/**
+ * \brief Get the number of records available.
+ *
+ * \param history History.
+ * \return Number of records, up to DHT_HISTORY_CAPACITY.
+ */
+uint dht_history_get_count(const dht_history_t *history);
+
+/**
+ * \brief Read a record.
+ *
+ * \param history History.
+ * \param age Record age: 0 is the newest record, 1 the one before, etc.
+ * \param[out] record Record.
+ * \return False if there is no record of that age.
+ */
+bool dht_history_get(const dht_history_t *history, uint age, dht_record_t *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _DHT_HISTORY_H_
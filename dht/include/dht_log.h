@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_LOG_H_
+#define _DHT_LOG_H_
+
+#include <dht.h>
+#include <hardware/flash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file dht_log.h
+ *
+ * \brief Append-only reading log in flash.
+ *
+ * Readings are packed into 8-byte records and collected in RAM, one flash page
+ * at a time. Full pages are programmed later from dht_log_task(), so sampling
+ * never waits for flash. The log region is a ring of sectors: each sector is
+ * erased just before its first page is written, dropping the oldest data, so
+ * wear is spread evenly over the region.
+ *
+ * Each page starts with a header holding its sequence number and the time of
+ * its first record, followed by records until the page is full or flushed.
+ * Unused record slots are left erased (all 0xFF).
+ */
+
+/** \brief Unit of record time deltas. */
+#ifndef DHT_LOG_TIME_UNIT_MS
+#define DHT_LOG_TIME_UNIT_MS 100
+#endif
+
+/** \brief Magic number of a log page header. */
+#define DHT_LOG_PAGE_MAGIC 0x474c4844 // "DHLG"
+
+/** \brief Sensor id of unused record slots. */
+#define DHT_LOG_UNUSED_SENSOR_ID 0xFF
+
+/**
+ * \brief Log record.
+ */
+typedef struct __attribute__((packed)) dht_log_record_t {
+    uint8_t sensor_id; /**< Application-defined sensor id, up to 254. */
+    uint8_t result; /**< Result status. */
+    uint16_t delta_time; /**< Time since the previous record of the page, in DHT_LOG_TIME_UNIT_MS. */
+    int16_t temperature_c_x10; /**< Tenths of a degree Celsius. Zero unless result is DHT_RESULT_OK. */
+    uint16_t humidity_x10; /**< Relative humidity, in tenths of a percent. Zero unless result is DHT_RESULT_OK. */
+} dht_log_record_t;
+
+/**
+ * \brief Log page header.
+ */
+typedef struct __attribute__((packed)) dht_log_page_header_t {
+    uint32_t magic; /**< DHT_LOG_PAGE_MAGIC. */
+    uint32_t sequence; /**< Incremented with every page written. */
+    uint64_t base_time_ms; /**< Time of the first record, as passed to dht_log_append(). */
+} dht_log_page_header_t;
+
+/** \brief Number of records per page. */
+#define DHT_LOG_RECORDS_PER_PAGE ((FLASH_PAGE_SIZE - sizeof(dht_log_page_header_t)) / sizeof(dht_log_record_t))
+
+/**
+ * \brief Flash log.
+ */
+typedef struct dht_log_t {
+    uint32_t flash_offset;
+    uint32_t page_count;
+    uint32_t next_page;
+    uint32_t next_sequence;
+    // pages are filled alternately; a full page waits in RAM until programmed
+    uint8_t pages[2][FLASH_PAGE_SIZE] __attribute__((aligned(4)));
+    volatile bool page_ready[2];
+    uint8_t fill_page;
+    uint8_t record_count;
+    uint64_t last_time_ms;
+    uint32_t dropped_count;
+} dht_log_t;
+
+/**
+ * \brief Initialize log.
+ *
+ * Scans the region for the newest page, so logging resumes after a reset. The
+ * region must not overlap the program image.
+ *
+ * \param log Log.
+ * \param flash_offset Region start, from the start of flash. Must be a multiple of FLASH_SECTOR_SIZE.
+ * \param size Region size. Must be a non-zero multiple of FLASH_SECTOR_SIZE.
+ */
+void dht_log_init(dht_log_t *log, uint32_t flash_offset, uint32_t size);
+
+/**
+ * \brief Append reading.
+ *
+ * Only copies the record to RAM, so it may be called from a completion
+ * callback. Must always be called from the same context.
+ *
+ * \param log Log.
+ * \param sensor_id Application-defined sensor id, up to 254.
+ * \param result Result status.
+ * \param humidity_x10 Relative humidity, in tenths of a percent.
+ * \param temperature_c_x10 Tenths of a degree Celsius.
+ * \param time_ms Reading time, e.g. milliseconds since boot or since the epoch. Must not decrease.
+ * \return False if the reading was dropped, because both RAM pages are waiting for dht_log_task().
+ */
+bool dht_log_append(dht_log_t *log, uint8_t sensor_id, dht_result_t result, int16_t humidity_x10, int16_t temperature_c_x10, uint64_t time_ms);
+
+/**
+ * \brief Program pages that are ready.
+ *
+ * Must be called regularly from thread context, not from an interrupt. Uses
+ * flash_safe_execute(), so the other core must allow being paused (see
+ * pico_flash).
+ *
+ * \param log Log.
+ */
+void dht_log_task(dht_log_t *log);
+
+/**
+ * \brief Program the current page, even if it isn't full.
+ *
+ * The rest of the page is left unused. Call before powering down.
+ * Same context requirements as dht_log_task(), and must not run concurrently
+ * with dht_log_append().
+ *
+ * \param log Log.
+ */
+void dht_log_flush(dht_log_t *log);
+
+/**
+ * \brief Stream the log contents over stdio.
+ *
+ * Writes every valid page, from oldest to newest, as raw FLASH_PAGE_SIZE
+ * blocks without newline translation, e.g. over USB CDC with pico_stdio_usb.
+ * Pages are self-describing through their header.
+ *
+ * \param log Log.
+ * \return Number of pages written.
+ */
+uint dht_log_dump(const dht_log_t *log);
+
+/**
+ * \brief Get the number of readings dropped so far.
+ *
+ * \param log Log.
+ * \return Dropped readings.
+ */
+uint32_t dht_log_get_dropped_count(const dht_log_t *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _DHT_LOG_H_
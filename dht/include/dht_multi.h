@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_MULTI_H_
+#define _DHT_MULTI_H_
+
+#include <dht.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file dht_multi.h
+ *
+ * \brief Measure many DHT sensors with a single state machine.
+ */
+
+/** \brief Maximum number of sensors, on consecutive pins. */
+#define DHT_MULTI_MAX_PINS 16
+
+/** \brief Interval between samples of the data lines. */
+#define DHT_MULTI_SAMPLE_PERIOD_US 10
+
+/** \brief Duration of sampling after the start signal. */
+#define DHT_MULTI_CAPTURE_US 6000
+
+#define DHT_MULTI_SAMPLE_COUNT (DHT_MULTI_CAPTURE_US / DHT_MULTI_SAMPLE_PERIOD_US)
+
+/**
+ * \brief DHT sensors sharing a state machine.
+ *
+ * All sensors must be of the same model. The state machine always ticks at
+ * DHT_PIO_SM_CLOCK_FREQUENCY, since the sample period and buffer depend on it.
+ */
+typedef struct dht_multi_t {
+    PIO pio;
+    uint8_t model;
+    uint8_t pio_program_offset;
+    uint8_t sm;
+    uint8_t dma_chan;
+    uint8_t base_pin;
+    uint8_t pin_count;
+    uint32_t start_signal_loops;
+    uint32_t start_time;
+    uint16_t samples[DHT_MULTI_SAMPLE_COUNT];
+} dht_multi_t;
+
+/**
+ * \brief Initialize sensors.
+ *
+ * The library claims one state machine and one DMA channel, regardless of how
+ * many sensors are connected. Samples taken on all pins are stored in dht_multi_t,
+ * which is about 1.2KB.
+ *
+ * \param multi Sensors.
+ * \param model DHT sensor model.
+ * \param pio PIO block to use (pio0, pio1, or pio2 on RP2350).
+ * \param base_pin First sensor data pin.
+ * \param pin_count Number of sensors, on pins starting from base_pin.
+ * \param pull_up Whether to enable the internal pull-ups.
+ */
+void dht_multi_init(dht_multi_t *multi, dht_model_t model, PIO pio, uint8_t base_pin, uint8_t pin_count, bool pull_up);
+
+/**
+ * \brief Deinitialize sensors.
+ *
+ * \param multi Sensors.
+ */
+void dht_multi_deinit(dht_multi_t *multi);
+
+/**
+ * \brief Update the state machine timing after changing clk_sys.
+ *
+ * The clock divider is derived from clk_sys when the sensors are initialized,
+ * like dht_sync_clock() does for a single sensor. Must not be called while a
+ * measurement is in progress.
+ *
+ * \param multi Sensors.
+ */
+void dht_multi_sync_clock(dht_multi_t *multi);
+
+/**
+ * \brief Start asynchronous measurement on all sensors.
+ *
+ * DHT sensors typically need at least 2 seconds between measurements for
+ * accurate results.
+ *
+ * \param multi Sensors.
+ */
+void dht_multi_start_measurement(dht_multi_t *multi);
+
+/**
+ * \brief Get the results if available, without blocking.
+ *
+ * \param multi Sensors.
+ * \param[out] readings Array receiving one reading per sensor, in pin order.
+ * \return DHT_RESULT_IN_PROGRESS while sampling, otherwise DHT_RESULT_OK and
+ * the readings are filled in.
+ */
+dht_result_t dht_multi_try_finish_measurement(dht_multi_t *multi, dht_reading_t *readings);
+
+/**
+ * \brief Wait for measurement to complete and get the results.
+ *
+ * \param multi Sensors.
+ * \param[out] readings Array receiving one reading per sensor, in pin order.
+ */
+void dht_multi_finish_measurement_blocking(dht_multi_t *multi, dht_reading_t *readings);
+
+/**
+ * \brief Get the raw frames if available, without blocking.
+ *
+ * Frames are written straight into the caller's array and only checked
+ * against their checksum, so they can be decoded as a batch.
+ *
+ * \param multi Sensors.
+ * \param[out] frames Array receiving one frame per sensor, in pin order.
+ * \param[out] results Array receiving one result per sensor. Frames are only
+ * valid where the result is DHT_RESULT_OK.
+ * \return DHT_RESULT_IN_PROGRESS while sampling, otherwise DHT_RESULT_OK and
+ * the frames and results are filled in.
+ */
+dht_result_t dht_multi_try_finish_measurement_raw(dht_multi_t *multi, dht_frame_t *frames, dht_result_t *results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _DHT_MULTI_H_
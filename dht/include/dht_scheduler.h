@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_SCHEDULER_H_
+#define _DHT_SCHEDULER_H_
+
+#include <dht.h>
+#include <pico/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file dht_scheduler.h
+ *
+ * \brief Periodic background sampling of DHT sensors.
+ */
+
+#ifndef DHT_SCHEDULER_MAX_SENSORS
+#define DHT_SCHEDULER_MAX_SENSORS 8
+#endif
+
+#ifndef DHT_SCHEDULER_DEFAULT_MAX_RETRIES
+#define DHT_SCHEDULER_DEFAULT_MAX_RETRIES 2
+#endif
+
+#ifndef DHT_SCHEDULER_DEFAULT_MAX_BACKOFF_SHIFT
+#define DHT_SCHEDULER_DEFAULT_MAX_BACKOFF_SHIFT 5
+#endif
+
+typedef struct dht_scheduler_t dht_scheduler_t;
+
+/**
+ * \brief Retry policy of a scheduled sensor.
+ *
+ * A measurement that fails with DHT_RESULT_BAD_CHECKSUM or DHT_RESULT_STALLED
+ * means the sensor is there but the frame got corrupted, so it's retried as
+ * soon as the minimum interval of the model allows. A measurement that fails
+ * with DHT_RESULT_TIMEOUT or DHT_RESULT_NO_RESPONSE means the sensor is likely
+ * disconnected, so it's not retried; instead, the sampling period doubles with
+ * each consecutive failed round, and returns to normal after a good reading.
+ */
+typedef struct dht_retry_policy_t {
+    uint max_retries; /**< Retries per round after a corrupted frame. */
+    uint max_backoff_shift; /**< The period of an unresponsive sensor grows up to `period << max_backoff_shift`. */
+} dht_retry_policy_t;
+
+/**
+ * \brief Scheduled sensor.
+ */
+typedef struct dht_scheduler_entry_t {
+    dht_scheduler_t *scheduler;
+    dht_t *dht;
+    dht_callback_t callback;
+    dht_callback_x10_t callback_x10;
+    void *user_data;
+    uint32_t period_us;
+    dht_retry_policy_t policy;
+    uint retry_count;
+    uint backoff_shift;
+    absolute_time_t round_time;
+    absolute_time_t attempt_time;
+    volatile alarm_id_t alarm;
+} dht_scheduler_entry_t;
+
+/**
+ * \brief Periodic sampling scheduler.
+ */
+struct dht_scheduler_t {
+    alarm_pool_t *alarm_pool;
+    uint32_t period_us;
+    uint count;
+    bool running;
+    dht_scheduler_entry_t entries[DHT_SCHEDULER_MAX_SENSORS];
+};
+
+/**
+ * \brief Initialize scheduler.
+ *
+ * \param scheduler Scheduler.
+ * \param alarm_pool Alarm pool driving the schedule, or NULL for the default pool.
+ * \param period_us Sampling period. Sensors are never measured more often than
+ * dht_get_min_interval_us() allows for their model.
+ */
+void dht_scheduler_init(dht_scheduler_t *scheduler, alarm_pool_t *alarm_pool, uint32_t period_us);
+
+/**
+ * \brief Register sensor with the scheduler.
+ *
+ * The scheduler takes over the sensor's completion callback (see
+ * dht_set_callback()), and forwards the final result of each round to the
+ * given callback from interrupt context. Must not be called while the
+ * scheduler is running.
+ *
+ * The sensor starts with the default retry policy:
+ * DHT_SCHEDULER_DEFAULT_MAX_RETRIES and DHT_SCHEDULER_DEFAULT_MAX_BACKOFF_SHIFT.
+ *
+ * \param scheduler Scheduler.
+ * \param dht Initialized DHT sensor, with no measurement in progress.
+ * \param callback Result callback. May be NULL.
+ * \param user_data User data passed to callback.
+ * \return Sensor index.
+ */
+uint dht_scheduler_add(dht_scheduler_t *scheduler, dht_t *dht, dht_callback_t callback, void *user_data);
+
+/**
+ * \brief Register sensor with the scheduler, with a fixed-point result callback.
+ *
+ * Same as dht_scheduler_add(), but values are forwarded as integer tenths,
+ * without floating point math in interrupt context.
+ *
+ * \param scheduler Scheduler.
+ * \param dht Initialized DHT sensor, with no measurement in progress.
+ * \param callback Result callback. May be NULL.
+ * \param user_data User data passed to callback.
+ * \return Sensor index.
+ */
+uint dht_scheduler_add_x10(dht_scheduler_t *scheduler, dht_t *dht, dht_callback_x10_t callback, void *user_data);
+
+/**
+ * \brief Change the retry policy of a sensor.
+ *
+ * Must not be called while the scheduler is running.
+ *
+ * \param scheduler Scheduler.
+ * \param index Sensor index, as returned by dht_scheduler_add().
+ * \param policy Retry policy. Zero retries and zero backoff shift disable the policy.
+ */
+void dht_scheduler_set_retry_policy(dht_scheduler_t *scheduler, uint index, const dht_retry_policy_t *policy);
+
+/**
+ * \brief Start periodic sampling.
+ *
+ * Sensor start times are staggered evenly across the sampling period.
+ *
+ * \param scheduler Scheduler.
+ */
+void dht_scheduler_start(dht_scheduler_t *scheduler);
+
+/**
+ * \brief Stop periodic sampling.
+ *
+ * A measurement already in progress still completes and is reported.
+ *
+ * \param scheduler Scheduler.
+ */
+void dht_scheduler_stop(dht_scheduler_t *scheduler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _DHT_SCHEDULER_H_
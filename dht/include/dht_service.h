@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _DHT_SERVICE_H_
+#define _DHT_SERVICE_H_
+
+#include <dht.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file dht_service.h
+ *
+ * \brief Acquisition service running on core 1.
+ *
+ * The service owns the registered sensors: it starts measurements on schedule,
+ * waits for them on core 1, and publishes timestamped readings to core 0
+ * through a lock-free queue. Core 0 never runs DHT timing code.
+ */
+
+#ifndef DHT_SERVICE_MAX_SENSORS
+#define DHT_SERVICE_MAX_SENSORS 8
+#endif
+
+/** \brief Capacity of the reading queue. Must be a power of two. */
+#ifndef DHT_SERVICE_QUEUE_SIZE
+#define DHT_SERVICE_QUEUE_SIZE 16
+#endif
+
+/**
+ * \brief Reading published by the service.
+ */
+typedef struct dht_service_reading_t {
+    uint64_t time_us; /**< Completion time, from time_us_64(). */
+    uint8_t sensor_index; /**< Sensor index, as returned by dht_service_add(). */
+    uint8_t result; /**< Result status. */
+    int16_t humidity_x10; /**< Relative humidity, in tenths of a percent. Only valid if result is DHT_RESULT_OK. */
+    int16_t temperature_c_x10; /**< Tenths of a degree Celsius. Only valid if result is DHT_RESULT_OK. */
+} dht_service_reading_t;
+
+/**
+ * \brief Register sensor with the service.
+ *
+ * Must be called on core 0 before dht_service_start(). The sensor must be
+ * initialized, not use a completion callback of either kind (so it can't be
+ * shared with dht_scheduler_t or dht_async_t), and must not be accessed by
+ * the application after registration.
+ *
+ * \param dht DHT sensor.
+ * \param period_us Sampling period. Clamped to dht_get_min_interval_us().
+ * \return Sensor index, reported in readings.
+ */
+uint dht_service_add(dht_t *dht, uint32_t period_us);
+
+/**
+ * \brief Launch the service on core 1.
+ *
+ * Core 1 must be unused. If notify is set, the sensor index of every reading is
+ * also pushed to the inter-core FIFO when there is room, so core 0 can wait on
+ * multicore_fifo_pop_blocking() or the SIO interrupt instead of polling.
+ *
+ * \param notify Whether to notify core 0 through the SIO FIFO.
+ */
+void dht_service_start(bool notify);
+
+/**
+ * \brief Get the next reading published by the service.
+ *
+ * Must only be called from core 0. Never blocks.
+ *
+ * \param[out] reading Oldest unread reading.
+ * \return False if no reading is available.
+ */
+bool dht_service_read(dht_service_reading_t *reading);
+
+/**
+ * \brief Get the number of readings dropped because the queue was full.
+ *
+ * \return Dropped readings since the service started.
+ */
+uint32_t dht_service_get_dropped_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _DHT_SERVICE_H_
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <dht.h>
+#include <hardware/clocks.h>
+#include <hardware/structs/systick.h>
+#include <pico/stdlib.h>
+#include <stdio.h>
+
+// change this to match your setup
+static const dht_model_t DHT_MODEL = DHT22;
+static const uint DATA_PIN = 15;
+// group mode measures these sensors in parallel, starting with the one on DATA_PIN
+static const uint GROUP_DATA_PINS[] = { 15, 16 };
+
+#define GROUP_SIZE count_of(GROUP_DATA_PINS)
+
+// samples per mode, each taking the sensor's minimum interval (2s on DHT22)
+#ifndef DHT_BENCH_SAMPLES
+#define DHT_BENCH_SAMPLES 50
+#endif
+
+// interval between polls in polling mode
+static const uint POLL_INTERVAL_US = 500;
+
+typedef struct bench_stats_t {
+    uint32_t cycles_min, cycles_max;
+    uint64_t cycles_sum;
+    uint32_t latency_min_us, latency_max_us;
+    uint64_t latency_sum_us;
+    uint ok_count;
+    uint failed_count;
+} bench_stats_t;
+
+typedef uint32_t (*bench_measure_t)(dht_t *dht, uint32_t *latency_us, dht_result_t *result);
+
+//
+// cycle counting
+//
+
+#if PICO_RP2040
+#define SYST_CSR_CLKSOURCE_BITS M0PLUS_SYST_CSR_CLKSOURCE_BITS
+#define SYST_CSR_ENABLE_BITS M0PLUS_SYST_CSR_ENABLE_BITS
+#else
+#define SYST_CSR_CLKSOURCE_BITS M33_SYST_CSR_CLKSOURCE_BITS
+#define SYST_CSR_ENABLE_BITS M33_SYST_CSR_ENABLE_BITS
+#endif
+
+static void systick_init(void) {
+    // count down from 2^24 - 1 at clk_sys
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = SYST_CSR_CLKSOURCE_BITS | SYST_CSR_ENABLE_BITS;
+}
+
+static inline uint32_t systick_get(void) {
+    return systick_hw->cvr;
+}
+
+// valid for intervals under 2^24 cycles (about 130ms at 125MHz)
+static inline uint32_t systick_elapsed(uint32_t start) {
+    return (start - systick_get()) & 0xFFFFFF;
+}
+
+static uint32_t us_to_cycles(uint32_t us) {
+    return (uint64_t)us * clock_get_hz(clk_sys) / 1000000;
+}
+
+//
+// modes
+//
+
+static uint32_t measure_blocking(dht_t *dht, uint32_t *latency_us, dht_result_t *result) {
+    uint32_t start_us = time_us_32();
+    uint32_t start = systick_get();
+    dht_start_measurement(dht);
+    *result = dht_finish_measurement_blocking(dht, NULL, NULL);
+    uint32_t cycles = systick_elapsed(start);
+    *latency_us = time_us_32() - start_us;
+    return cycles;
+}
+
+static uint32_t measure_polling(dht_t *dht, uint32_t *latency_us, dht_result_t *result) {
+    uint32_t start_us = time_us_32();
+    uint32_t start = systick_get();
+    dht_start_measurement(dht);
+    uint32_t cycles = systick_elapsed(start);
+    while (true) {
+        start = systick_get();
+        *result = dht_try_finish_measurement(dht, NULL, NULL);
+        cycles += systick_elapsed(start);
+        if (*result != DHT_RESULT_IN_PROGRESS) {
+            break;
+        }
+        busy_wait_us_32(POLL_INTERVAL_US);
+    }
+    *latency_us = time_us_32() - start_us;
+    return cycles;
+}
+
+static volatile bool irq_done;
+static volatile dht_result_t irq_result;
+static volatile uint32_t irq_time_us;
+static float idle_cycles_per_iteration;
+
+static void irq_callback(dht_t *dht, dht_result_t result, float humidity, float temperature_c, void *user_data) {
+    irq_time_us = time_us_32();
+    irq_result = result;
+    irq_done = true;
+}
+
+// Time spent in interrupts can't be measured directly, so count how much an
+// idle loop slows down while the measurement is running.
+static uint32_t run_idle_loop(uint32_t duration_us) {
+    uint32_t iterations = 0;
+    uint32_t start_us = time_us_32();
+    while (!irq_done && time_us_32() - start_us < duration_us) {
+        iterations++;
+    }
+    return iterations;
+}
+
+static void calibrate_idle_loop(void) {
+    const uint32_t duration_us = 20000;
+    irq_done = false;
+    uint32_t iterations = run_idle_loop(duration_us);
+    idle_cycles_per_iteration = (float)us_to_cycles(duration_us) / iterations;
+}
+
+static uint32_t measure_irq(dht_t *dht, uint32_t *latency_us, dht_result_t *result) {
+    irq_done = false;
+    uint32_t start_us = time_us_32();
+    uint32_t start = systick_get();
+    dht_start_measurement(dht);
+    uint32_t cycles = systick_elapsed(start);
+    uint32_t idle_start_us = time_us_32();
+    uint32_t iterations = run_idle_loop(UINT32_MAX);
+    uint32_t idle_us = time_us_32() - idle_start_us;
+    *latency_us = irq_time_us - start_us;
+    *result = irq_result;
+    float stolen = us_to_cycles(idle_us) - iterations * idle_cycles_per_iteration;
+    return cycles + (stolen > 0 ? (uint32_t)stolen : 0);
+}
+
+// cycles and latency are for the whole group, the result is OK only if all sensors succeeded
+static uint32_t measure_group(dht_t *sensors, uint32_t *latency_us, dht_result_t *result) {
+    dht_group_t group;
+    dht_group_init(&group, sensors, GROUP_SIZE);
+    dht_reading_t readings[GROUP_SIZE];
+    uint32_t start_us = time_us_32();
+    uint32_t start = systick_get();
+    dht_group_start_measurement(&group);
+    dht_group_finish_measurement_blocking(&group, readings);
+    uint32_t cycles = systick_elapsed(start);
+    *latency_us = time_us_32() - start_us;
+    *result = DHT_RESULT_OK;
+    for (uint i = 0; i < GROUP_SIZE; i++) {
+        if (readings[i].result != DHT_RESULT_OK) {
+            *result = readings[i].result;
+        }
+    }
+    return cycles;
+}
+
+//
+// runner
+//
+
+static void run(const char *name, dht_t *dht, bench_measure_t measure) {
+    bench_stats_t stats = {
+        .cycles_min = UINT32_MAX,
+        .latency_min_us = UINT32_MAX,
+    };
+    printf("%s: %u samples\n", name, DHT_BENCH_SAMPLES);
+    for (uint i = 0; i < DHT_BENCH_SAMPLES; i++) {
+        uint32_t latency_us;
+        dht_result_t result;
+        uint32_t cycles = measure(dht, &latency_us, &result);
+        if (result != DHT_RESULT_OK) {
+            stats.failed_count++;
+        } else {
+            stats.ok_count++;
+            stats.cycles_min = MIN(stats.cycles_min, cycles);
+            stats.cycles_max = MAX(stats.cycles_max, cycles);
+            stats.cycles_sum += cycles;
+            stats.latency_min_us = MIN(stats.latency_min_us, latency_us);
+            stats.latency_max_us = MAX(stats.latency_max_us, latency_us);
+            stats.latency_sum_us += latency_us;
+        }
+        sleep_us(dht_get_min_interval_us(DHT_MODEL) - latency_us);
+    }
+    if (stats.ok_count == 0) {
+        printf("  no successful measurements (%u failed)\n", stats.failed_count);
+        return;
+    }
+    printf("  cpu cycles: min %lu, avg %lu, max %lu\n",
+            (unsigned long)stats.cycles_min, (unsigned long)(stats.cycles_sum / stats.ok_count), (unsigned long)stats.cycles_max);
+    printf("  latency us: min %lu, avg %lu, max %lu\n",
+            (unsigned long)stats.latency_min_us, (unsigned long)(stats.latency_sum_us / stats.ok_count), (unsigned long)stats.latency_max_us);
+    printf("  ok %u, failed %u\n", stats.ok_count, stats.failed_count);
+}
+
+int main() {
+    stdio_init_all();
+    printf("\nDHT benchmark, clk_sys %lu Hz\n", (unsigned long)clock_get_hz(clk_sys));
+
+    systick_init();
+    calibrate_idle_loop();
+
+    // the group measures all sensors, the other modes only the first one
+    static dht_t sensors[GROUP_SIZE];
+    for (uint i = 0; i < GROUP_SIZE; i++) {
+        dht_init(&sensors[i], DHT_MODEL, pio0, GROUP_DATA_PINS[i], true /* pull_up */);
+    }
+    sleep_us(dht_get_min_interval_us(DHT_MODEL));
+    printf("%u samples per mode, about %lu s in total\n", DHT_BENCH_SAMPLES,
+            (unsigned long)((uint64_t)4 * DHT_BENCH_SAMPLES * dht_get_min_interval_us(DHT_MODEL) / 1000000));
+
+    dht_t *dht = &sensors[0];
+    assert(GROUP_DATA_PINS[0] == DATA_PIN);
+    run("blocking", dht, measure_blocking);
+    run("polling", dht, measure_polling);
+    dht_set_callback(dht, irq_callback, NULL);
+    run("irq", dht, measure_irq);
+    dht_set_callback(dht, NULL, NULL);
+    run("group", sensors, measure_group);
+
+    puts("done");
+    while (true) {
+        tight_loop_contents();
+    }
+}
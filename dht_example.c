@@ -30,8 +30,10 @@ int main() {
         dht_result_t result = dht_finish_measurement_blocking(&dht, &humidity, &temperature_c);
         if (result == DHT_RESULT_OK) {
             printf("%.1f C (%.1f F), %.1f%% humidity\n", temperature_c, celsius_to_fahrenheit(temperature_c), humidity);
-        } else if (result == DHT_RESULT_TIMEOUT) {
+        } else if (result == DHT_RESULT_TIMEOUT || result == DHT_RESULT_NO_RESPONSE) {
             puts("DHT sensor not responding. Please check your wiring.");
+        } else if (result == DHT_RESULT_STALLED) {
+            puts("Incomplete data");
         } else {
             assert(result == DHT_RESULT_BAD_CHECKSUM);
             puts("Bad checksum");
@@ -0,0 +1,665 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// Host regression tests and throughput numbers for frame decoding, plus a
+// cycle-accurate replay of dht.pio against synthetic sensor waveforms.
+
+#include "pio_sim.h"
+#include <dht.h>
+#include <dht_decode.h>
+#include <dht_timing.h>
+#include <dht_filter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DHT_PIO_PATH
+#define DHT_PIO_PATH "../dht/dht.pio"
+#endif
+
+static unsigned failure_count;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            failure_count++; \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+        } \
+    } while (0)
+
+static const char *const model_names[] = { "DHT11", "DHT12", "DHT21", "DHT22" };
+
+static void make_frame(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3, uint8_t frame[5]) {
+    frame[0] = b0;
+    frame[1] = b1;
+    frame[2] = b2;
+    frame[3] = b3;
+    frame[4] = b0 + b1 + b2 + b3;
+}
+
+//
+// frame decoding
+//
+
+typedef struct frame_case_t {
+    dht_model_t model;
+    uint8_t frame[5];
+    dht_result_t result;
+    int16_t humidity_x10;
+    int16_t temperature_c_x10;
+} frame_case_t;
+
+// recorded from real sensors, and edge cases of each encoding
+static const frame_case_t frame_cases[] = {
+    { DHT11, { 0x25, 0x00, 0x18, 0x03, 0x40 }, DHT_RESULT_OK, 370, 243 },
+    { DHT11, { 0x00, 0x00, 0x00, 0x00, 0x00 }, DHT_RESULT_OK, 0, 0 },
+    { DHT11, { 0x5F, 0x00, 0x32, 0x00, 0x91 }, DHT_RESULT_OK, 950, 500 },
+    // DHT11 can't report below-zero temperatures, the sign bit reads as 0
+    { DHT11, { 0x14, 0x00, 0x01, 0x85, 0x9A }, DHT_RESULT_OK, 200, 0 },
+    { DHT11, { 0x25, 0x00, 0x18, 0x03, 0x41 }, DHT_RESULT_BAD_CHECKSUM, 0, 0 },
+    { DHT12, { 0x38, 0x02, 0x17, 0x06, 0x57 }, DHT_RESULT_OK, 562, 236 },
+    { DHT12, { 0x38, 0x02, 0x05, 0x83, 0xC2 }, DHT_RESULT_OK, 562, -53 },
+    { DHT21, { 0x01, 0xC2, 0x00, 0xEB, 0xAE }, DHT_RESULT_OK, 450, 235 },
+    { DHT21, { 0x03, 0xE8, 0x80, 0x01, 0x6C }, DHT_RESULT_OK, 1000, -1 },
+    { DHT22, { 0x02, 0x8C, 0x01, 0x5F, 0xEE }, DHT_RESULT_OK, 652, 351 },
+    { DHT22, { 0x01, 0xF4, 0x80, 0x65, 0xDA }, DHT_RESULT_OK, 500, -101 },
+    { DHT22, { 0x00, 0x00, 0x81, 0x90, 0x11 }, DHT_RESULT_OK, 0, -400 },
+    { DHT22, { 0x02, 0x8C, 0x01, 0x5F, 0xEF }, DHT_RESULT_BAD_CHECKSUM, 0, 0 },
+    // checksum wraps around
+    { DHT22, { 0xFF, 0xFF, 0x7F, 0xFF, 0x7C }, DHT_RESULT_OK, -1, 32767 },
+};
+
+static void test_decode_frames(void) {
+    for (unsigned i = 0; i < sizeof(frame_cases) / sizeof(frame_cases[0]); i++) {
+        const frame_case_t *c = &frame_cases[i];
+        int16_t humidity_x10 = 0, temperature_c_x10 = 0;
+        dht_result_t result = dht_decode_frame_x10(c->model, c->frame, &humidity_x10, &temperature_c_x10);
+        CHECK(result == c->result, "frame case %u: result %d, expected %d", i, result, c->result);
+        if (result == DHT_RESULT_OK && c->result == DHT_RESULT_OK) {
+            CHECK(humidity_x10 == c->humidity_x10, "frame case %u: humidity %d, expected %d", i, humidity_x10, c->humidity_x10);
+            CHECK(temperature_c_x10 == c->temperature_c_x10, "frame case %u: temperature %d, expected %d", i, temperature_c_x10, c->temperature_c_x10);
+        }
+    }
+}
+
+// model detection relies on frames of one family failing the other's check
+static void test_frame_plausibility(void) {
+    for (unsigned i = 0; i < sizeof(frame_cases) / sizeof(frame_cases[0]); i++) {
+        const frame_case_t *c = &frame_cases[i];
+        if (c->result != DHT_RESULT_OK) {
+            continue;
+        }
+        bool is_dht1x = (c->model == DHT11 || c->model == DHT12);
+        dht_model_t other = is_dht1x ? DHT22 : DHT11;
+        // out of range on purpose
+        bool in_range = !(c->model == DHT22 && c->humidity_x10 < 0);
+        bool all_zero = (c->frame[0] | c->frame[1] | c->frame[2] | c->frame[3]) == 0;
+        CHECK(dht_frame_is_plausible(c->model, c->frame) == in_range, "frame case %u: plausibility as %s", i, model_names[c->model]);
+        CHECK(dht_frame_is_plausible(other, c->frame) == all_zero, "frame case %u: plausibility as %s", i, model_names[other]);
+        if (is_dht1x) {
+            // including the DHT11 frame with the sign bit set
+            CHECK(dht_frame_is_plausible(DHT11, c->frame) && dht_frame_is_plausible(DHT12, c->frame), "frame case %u: DHT11/DHT12 told apart", i);
+        }
+    }
+
+    // so detection keeps a configured DHT11/DHT12, and otherwise assumes DHT12
+    static const dht_model_t resolved[] = { DHT11, DHT12, DHT12, DHT12 };
+    for (int model = DHT11; model <= DHT22; model++) {
+        dht_model_t detected = dht_resolve_dht1x_model(model);
+        CHECK(detected == resolved[model], "configured %s: resolved as %s", model_names[model], model_names[detected]);
+    }
+}
+
+// deterministic pseudo-random frames, two thirds with a valid checksum
+static void make_random_frames(dht_frame_t *frames, unsigned count, uint32_t seed) {
+    for (unsigned i = 0; i < count; i++) {
+        for (unsigned b = 0; b < 5; b++) {
+            seed = seed * 1664525u + 1013904223u;
+            frames[i].bytes[b] = seed >> 24;
+        }
+        if (i % 3 != 0) {
+            frames[i].bytes[4] = frames[i].bytes[0] + frames[i].bytes[1] + frames[i].bytes[2] + frames[i].bytes[3];
+        }
+    }
+}
+
+static void test_decode_batch(void) {
+    enum { COUNT = 1000 };
+    static dht_frame_t frames[COUNT];
+    static dht_values_x10_t values[COUNT];
+    uint32_t invalid_mask[DHT_BATCH_MASK_WORDS(COUNT)];
+    make_random_frames(frames, COUNT, 12345);
+    for (int model = DHT11; model <= DHT22; model++) {
+        uint32_t invalid_count = dht_decode_batch(model, frames, COUNT, values, invalid_mask);
+        uint32_t expected_invalid = 0;
+        for (unsigned i = 0; i < COUNT; i++) {
+            int16_t h = 0, t = 0;
+            dht_result_t result = dht_decode_frame_x10(model, frames[i].bytes, &h, &t);
+            bool invalid = (invalid_mask[i / 32] >> (i % 32)) & 1;
+            CHECK(invalid == (result != DHT_RESULT_OK), "%s batch %u: invalid bit %d", model_names[model], i, invalid);
+            if (result == DHT_RESULT_OK) {
+                CHECK(values[i].humidity_x10 == h && values[i].temperature_c_x10 == t, "%s batch %u: decoded %d/%d, expected %d/%d",
+                        model_names[model], i, values[i].humidity_x10, values[i].temperature_c_x10, h, t);
+            } else {
+                expected_invalid++;
+                CHECK(values[i].humidity_x10 == 0 && values[i].temperature_c_x10 == 0, "%s batch %u: invalid frame not zeroed", model_names[model], i);
+            }
+        }
+        CHECK(invalid_count == expected_invalid, "%s batch: %u invalid, expected %u", model_names[model], invalid_count, expected_invalid);
+    }
+
+    // recorded frames, and the mask is optional
+    for (unsigned i = 0; i < sizeof(frame_cases) / sizeof(frame_cases[0]); i++) {
+        const frame_case_t *c = &frame_cases[i];
+        memcpy(frames[0].bytes, c->frame, 5);
+        uint32_t invalid_count = dht_decode_batch(c->model, frames, 1, values, NULL);
+        CHECK(invalid_count == (c->result != DHT_RESULT_OK), "frame case %u: batch invalid count %u", i, invalid_count);
+        if (c->result == DHT_RESULT_OK) {
+            CHECK(values[0].humidity_x10 == c->humidity_x10 && values[0].temperature_c_x10 == c->temperature_c_x10, "frame case %u: batch values", i);
+        }
+    }
+}
+
+//
+// pulse decoding
+//
+
+static void make_pulses(const uint8_t frame[5], uint32_t short_us, uint32_t long_us, uint32_t jitter_us, uint32_t widths[DHT_PULSE_COUNT]) {
+    for (unsigned i = 0; i < DHT_PULSE_COUNT; i++) {
+        bool bit = frame[i / 8] & (0x80 >> (i % 8));
+        // deterministic jitter in [-jitter_us, +jitter_us]
+        int32_t jitter = jitter_us ? (int32_t)((i * 7919u) % (2 * jitter_us + 1)) - (int32_t)jitter_us : 0;
+        widths[i] = (bit ? long_us : short_us) + jitter;
+    }
+}
+
+static void test_decode_pulses(void) {
+    static const struct {
+        uint32_t short_us, long_us, jitter_us;
+    } timings[] = {
+        { 27, 70, 0 }, // nominal
+        { 24, 74, 3 }, // jittery
+        { 40, 90, 4 }, // stretched by a long cable, beyond the fixed threshold
+        { 15, 42, 2 }, // fast sensor, beyond the fixed threshold
+    };
+    uint8_t frame[5], decoded[5];
+    uint32_t widths[DHT_PULSE_COUNT];
+    for (unsigned i = 0; i < sizeof(frame_cases) / sizeof(frame_cases[0]); i++) {
+        for (unsigned j = 0; j < sizeof(timings) / sizeof(timings[0]); j++) {
+            const uint8_t *expected = frame_cases[i].frame;
+            uint32_t mixed = expected[0] | expected[1] | expected[2] | expected[3] | expected[4];
+            uint32_t common = expected[0] & expected[1] & expected[2] & expected[3] & expected[4];
+            if ((mixed == 0 || common == 0xFF) && (timings[j].short_us >= 50 || timings[j].long_us < 50)) {
+                continue; // uniform frames can't be told apart from off-spec timing
+            }
+            make_pulses(expected, timings[j].short_us, timings[j].long_us, timings[j].jitter_us, widths);
+            dht_decode_pulses(widths, decoded);
+            CHECK(memcmp(decoded, expected, 5) == 0, "pulse case %u/%u: decoded %02x%02x%02x%02x%02x", i, j,
+                    decoded[0], decoded[1], decoded[2], decoded[3], decoded[4]);
+        }
+    }
+    // all bits the same, the fixed threshold applies
+    make_frame(0, 0, 0, 0, frame);
+    make_pulses(frame, 27, 70, 2, widths);
+    dht_decode_pulses(widths, decoded);
+    CHECK(memcmp(decoded, frame, 5) == 0, "all-zero pulses");
+    memset(frame, 0xFF, 5);
+    make_pulses(frame, 27, 70, 2, widths);
+    CHECK(dht_decode_pulses(widths, decoded) == DHT_LONG_PULSE_THRESHOLD_US, "all-one pulses threshold");
+    CHECK(memcmp(decoded, frame, 5) == 0, "all-one pulses");
+}
+
+//
+// filtering
+//
+
+static void test_filter(void) {
+    dht_filter_t filter;
+    dht_filter_config_t config = dht_filter_get_default_config();
+    int16_t h, t;
+
+    // median alone drops a single spike
+    config.ema_shift = 0;
+    config.max_humidity_step_x10 = 0;
+    config.max_temperature_step_x10 = 0;
+    dht_filter_init(&filter, &config);
+    static const int16_t spikes[] = { 200, 201, 400, 202, 203 };
+    static const int16_t medians[] = { 200, 200, 201, 202, 203 };
+    for (unsigned i = 0; i < 5; i++) {
+        h = 500;
+        t = spikes[i];
+        CHECK(dht_filter_update(&filter, &h, &t), "median %u rejected", i);
+        CHECK(t == medians[i] && h == 500, "median %u: %d", i, t);
+    }
+
+    // EMA converges on a step without overshooting
+    config = dht_filter_get_default_config();
+    config.median_window = 1;
+    config.max_humidity_step_x10 = 0;
+    config.max_temperature_step_x10 = 0;
+    dht_filter_init(&filter, &config);
+    int16_t previous = -100;
+    for (unsigned i = 0; i < 40; i++) {
+        h = 0;
+        t = (i == 0) ? -100 : 100;
+        dht_filter_update(&filter, &h, &t);
+        CHECK(t >= previous && t <= 100, "ema %u: %d", i, t);
+        previous = t;
+    }
+    CHECK(previous == 100, "ema settled at %d", previous);
+
+    // outliers are rejected, but a persistent change is followed
+    config = dht_filter_get_default_config();
+    config.median_window = 1;
+    config.ema_shift = 0;
+    dht_filter_init(&filter, &config);
+    h = 500, t = 200;
+    CHECK(dht_filter_update(&filter, &h, &t), "first reading rejected");
+    h = 500, t = 900;
+    CHECK(!dht_filter_update(&filter, &h, &t) && t == 900, "outlier accepted");
+    h = 500, t = 210;
+    CHECK(dht_filter_update(&filter, &h, &t) && t == 210, "normal reading after outlier");
+    for (unsigned i = 0; i < config.max_rejections; i++) {
+        h = 800, t = 210;
+        CHECK(!dht_filter_update(&filter, &h, &t), "humidity step %u accepted", i);
+    }
+    h = 800, t = 210;
+    CHECK(dht_filter_update(&filter, &h, &t) && h == 800, "persistent step not followed");
+}
+
+//
+// PIO replay
+//
+
+// Waveform of a sensor on the data line, which is pulled up while idle.
+typedef struct sensor_t {
+    bool present;
+    const uint8_t *frame;
+    unsigned bit_count; // stops sending after this many bits
+    uint32_t short_us, long_us;
+    uint32_t min_start_us;
+    uint32_t release_us; // from the end of the start signal to the response
+    uint32_t ack_low_us, ack_high_us;
+    uint32_t rise_ns; // the line still reads low for this long after the host releases it
+    bool line_low;
+    uint64_t low_since;
+    int64_t response_start;
+} sensor_t;
+
+static void sensor_init(sensor_t *sensor, dht_model_t model, const uint8_t *frame) {
+    memset(sensor, 0, sizeof(sensor_t));
+    sensor->present = true;
+    sensor->frame = frame;
+    sensor->bit_count = DHT_PULSE_COUNT;
+    sensor->short_us = 26;
+    sensor->long_us = 70;
+    // wake up a bit before the nominal start pulse ends
+    sensor->min_start_us = dht_get_start_pulse_duration_us(model) * 8 / 10;
+    sensor->release_us = 30;
+    sensor->ack_low_us = 80;
+    sensor->ack_high_us = 80;
+    sensor->response_start = -1;
+}
+
+static bool sensor_get_level(sensor_t *sensor, uint64_t t, bool host_low) {
+    if (host_low) {
+        if (!sensor->line_low) {
+            sensor->line_low = true;
+            sensor->low_since = t;
+        }
+        sensor->response_start = -1;
+        return false;
+    }
+    if (sensor->line_low) {
+        sensor->line_low = false;
+        if (sensor->present && t - sensor->low_since >= sensor->min_start_us) {
+            sensor->response_start = t + sensor->release_us;
+        }
+    }
+    if (sensor->response_start < 0 || (int64_t)t < sensor->response_start) {
+        return true;
+    }
+    uint64_t rel = t - sensor->response_start;
+    // acknowledge: low, then high
+    if (rel < sensor->ack_low_us) {
+        return false;
+    }
+    if (rel < sensor->ack_low_us + sensor->ack_high_us) {
+        return true;
+    }
+    rel -= sensor->ack_low_us + sensor->ack_high_us;
+    for (unsigned i = 0; i < sensor->bit_count; i++) {
+        bool bit = sensor->frame[i / 8] & (0x80 >> (i % 8));
+        uint32_t high_us = bit ? sensor->long_us : sensor->short_us;
+        if (rel < 50) {
+            return false;
+        }
+        if (rel < 50 + high_us) {
+            return true;
+        }
+        rel -= 50 + high_us;
+    }
+    if (sensor->bit_count < DHT_PULSE_COUNT) {
+        return true; // stalled, line floats high
+    }
+    // end of frame: 50us low, then release
+    return rel >= 50;
+}
+
+typedef struct replay_t {
+    pio_sim_program_t bits_program;
+    pio_sim_program_t pulses_program;
+    pio_sim_program_t compact_program;
+} replay_t;
+
+// Mirrors dht_init() and dht_program_restart(), then runs until the expected
+// number of words arrives, or for run_us (0 until the measurement times out).
+static void replay_for(const pio_sim_program_t *program, bool capture_pulses, dht_model_t model, sensor_t *sensor, pio_sim_t *sim, uint32_t clock_frequency, uint32_t run_us) {
+    uint32_t start_us = dht_get_start_pulse_duration_us(model);
+    int start_clocks_per_loop = pio_sim_get_define(program, "start_signal_clocks_per_loop");
+    int pulse_clocks_per_loop = pio_sim_get_define(program, "pulse_measurement_clocks_per_loop");
+    uint32_t clocks_per_us = clock_frequency / 1000000;
+
+    pio_sim_init(sim, program);
+    sim->autopush = !capture_pulses;
+    sim->push_threshold = capture_pulses ? 32 : 8;
+    sim->pindirs = 1;
+    sim->y = dht_get_pio_sm_loops(clock_frequency, start_us, start_clocks_per_loop);
+    sim->osr = dht_get_pio_sm_loops(clock_frequency, DHT_LONG_PULSE_THRESHOLD_US, pulse_clocks_per_loop);
+
+    unsigned expected = capture_pulses ? DHT_PULSE_COUNT : 5;
+    if (run_us == 0) {
+        run_us = start_us + DHT_MEASUREMENT_TIMEOUT_US;
+    }
+    uint64_t timeout_cycles = (uint64_t)run_us * clocks_per_us;
+    uint64_t rise_cycles = (uint64_t)sensor->rise_ns * clocks_per_us / 1000;
+    uint64_t rising_until = 0;
+    bool was_host_low = false;
+    while (sim->rx_count < expected && sim->cycle < timeout_cycles) {
+        bool host_low = (sim->pindirs & 1) && !(sim->pins & 1);
+        if (was_host_low && !host_low) {
+            rising_until = sim->cycle + rise_cycles;
+        }
+        was_host_low = host_low;
+        bool level = sensor_get_level(sensor, sim->cycle / clocks_per_us, host_low) && !host_low && sim->cycle >= rising_until;
+        pio_sim_step(sim, level ? 1 : 0);
+    }
+}
+
+static void replay_at(const pio_sim_program_t *program, bool capture_pulses, dht_model_t model, sensor_t *sensor, pio_sim_t *sim, uint32_t clock_frequency) {
+    replay_for(program, capture_pulses, model, sensor, sim, clock_frequency, 0);
+}
+
+// mirrors is_waiting_for_response()
+static bool is_waiting_for_response(const pio_sim_t *sim) {
+    return (int)sim->pc <= pio_sim_get_label(sim->program, "loop_until_ready_lo");
+}
+
+static void replay(const pio_sim_program_t *program, bool capture_pulses, dht_model_t model, sensor_t *sensor, pio_sim_t *sim) {
+    replay_at(program, capture_pulses, model, sensor, sim, DHT_PIO_SM_CLOCK_FREQUENCY);
+}
+
+static void test_pio_replay(const replay_t *r) {
+    uint8_t frame[5];
+    for (int model = DHT11; model <= DHT22; model++) {
+        for (unsigned i = 0; i < sizeof(frame_cases) / sizeof(frame_cases[0]); i++) {
+            if (frame_cases[i].model != (dht_model_t)model) {
+                continue;
+            }
+            sensor_t sensor;
+            pio_sim_t sim;
+            // bit mode
+            sensor_init(&sensor, model, frame_cases[i].frame);
+            replay(&r->bits_program, false, model, &sensor, &sim);
+            CHECK(sim.rx_count == 5, "%s replay %u: received %u bytes", model_names[model], i, sim.rx_count);
+            for (unsigned b = 0; b < 5; b++) {
+                frame[b] = sim.rx[b] & 0xFF;
+            }
+            CHECK(memcmp(frame, frame_cases[i].frame, 5) == 0, "%s replay %u: frame mismatch", model_names[model], i);
+            CHECK((sim.pindirs & 1) == 0, "%s replay %u: line still driven", model_names[model], i);
+
+            // compact program must produce the same bytes
+            sensor_init(&sensor, model, frame_cases[i].frame);
+            replay(&r->compact_program, false, model, &sensor, &sim);
+            CHECK(sim.rx_count == 5, "%s compact replay %u: received %u bytes", model_names[model], i, sim.rx_count);
+            for (unsigned b = 0; b < 5; b++) {
+                frame[b] = sim.rx[b] & 0xFF;
+            }
+            CHECK(memcmp(frame, frame_cases[i].frame, 5) == 0, "%s compact replay %u: frame mismatch", model_names[model], i);
+
+            // pulse mode
+            sensor_init(&sensor, model, frame_cases[i].frame);
+            replay(&r->pulses_program, true, model, &sensor, &sim);
+            CHECK(sim.rx_count == DHT_PULSE_COUNT, "%s pulse replay %u: received %u widths", model_names[model], i, sim.rx_count);
+            uint32_t widths[DHT_PULSE_COUNT];
+            int clocks_per_loop = pio_sim_get_define(&r->pulses_program, "pulse_measurement_clocks_per_loop");
+            for (unsigned b = 0; b < DHT_PULSE_COUNT; b++) {
+                widths[b] = sim.rx[b] * clocks_per_loop;
+                bool bit = frame_cases[i].frame[b / 8] & (0x80 >> (b % 8));
+                int32_t error = (int32_t)widths[b] - (int32_t)(bit ? sensor.long_us : sensor.short_us);
+                CHECK(error >= -2 && error <= 2, "%s pulse replay %u: bit %u width %u", model_names[model], i, b, widths[b]);
+            }
+            dht_decode_pulses(widths, frame);
+            CHECK(memcmp(frame, frame_cases[i].frame, 5) == 0, "%s pulse replay %u: frame mismatch", model_names[model], i);
+        }
+    }
+
+    // missing sensor: the program must still be waiting for the response, which
+    // is how check_measurement() reports DHT_RESULT_NO_RESPONSE
+    sensor_t sensor;
+    pio_sim_t sim;
+    make_frame(1, 2, 3, 4, frame);
+    sensor_init(&sensor, DHT22, frame);
+    sensor.present = false;
+    replay(&r->bits_program, false, DHT22, &sensor, &sim);
+    CHECK(sim.rx_count == 0 && is_waiting_for_response(&sim), "no response: %u bytes, pc %u", sim.rx_count, sim.pc);
+
+    // sensor stops in the middle of the frame
+    sensor_init(&sensor, DHT22, frame);
+    sensor.bit_count = 20;
+    replay(&r->bits_program, false, DHT22, &sensor, &sim);
+    CHECK(sim.rx_count == 2, "stalled: received %u bytes", sim.rx_count);
+
+    // instruction counts as documented in dht.h and README.md
+    CHECK(r->compact_program.length == 10 && r->bits_program.length == 18, "compact program: %u instructions, instead of %u",
+            r->compact_program.length, r->bits_program.length);
+
+    // same checks for the compact program
+    sensor_init(&sensor, DHT22, frame);
+    sensor.present = false;
+    replay(&r->compact_program, false, DHT22, &sensor, &sim);
+    CHECK(sim.rx_count == 0 && is_waiting_for_response(&sim), "compact no response: %u bytes, pc %u", sim.rx_count, sim.pc);
+    sensor_init(&sensor, DHT22, frame);
+    sensor.bit_count = 20;
+    replay(&r->compact_program, false, DHT22, &sensor, &sim);
+    CHECK(sim.rx_count == 2, "compact stalled: received %u bytes", sim.rx_count);
+
+    // slow but in-spec acknowledge (370us in total) must pass the response and
+    // first byte deadlines of check_measurement()
+    const pio_sim_program_t *const programs[] = { &r->bits_program, &r->pulses_program, &r->compact_program };
+    for (unsigned p = 0; p < 3; p++) {
+        bool capture_pulses = (programs[p] == &r->pulses_program);
+        for (int model = DHT11; model <= DHT22; model++) {
+            uint32_t start_us = dht_get_start_pulse_duration_us(model);
+            uint32_t response_deadline_us = start_us + DHT_RESPONSE_TIMEOUT_US;
+            sensor_init(&sensor, model, frame);
+            sensor.release_us = 40;
+            sensor.ack_low_us = 160;
+            sensor.ack_high_us = 170;
+            replay_for(programs[p], capture_pulses, model, &sensor, &sim, DHT_PIO_SM_CLOCK_FREQUENCY, response_deadline_us);
+            CHECK(!is_waiting_for_response(&sim), "%s slow response, program %u: still waiting, pc %u", model_names[model], p, sim.pc);
+
+            sensor_init(&sensor, model, frame);
+            sensor.release_us = 40;
+            sensor.ack_low_us = 160;
+            sensor.ack_high_us = 170;
+            uint32_t first_deadline_us = response_deadline_us + DHT_ACKNOWLEDGE_TIMEOUT_US + (capture_pulses ? 1 : 8) * DHT_BIT_TIMEOUT_US;
+            replay_for(programs[p], capture_pulses, model, &sensor, &sim, DHT_PIO_SM_CLOCK_FREQUENCY, first_deadline_us);
+            CHECK(sim.rx_count >= 1, "%s slow response, program %u: nothing received by the first deadline", model_names[model], p);
+
+            sensor_init(&sensor, model, frame);
+            sensor.release_us = 40;
+            sensor.ack_low_us = 160;
+            sensor.ack_high_us = 170;
+            replay(programs[p], capture_pulses, model, &sensor, &sim);
+            CHECK(sim.rx_count == (capture_pulses ? DHT_PULSE_COUNT : 5u), "%s slow response, program %u: received %u words", model_names[model], p, sim.rx_count);
+            if (!capture_pulses) {
+                uint8_t received[5];
+                for (unsigned b = 0; b < 5; b++) {
+                    received[b] = sim.rx[b] & 0xFF;
+                }
+                CHECK(memcmp(received, frame, 5) == 0, "%s slow response, program %u: frame mismatch", model_names[model], p);
+            }
+        }
+    }
+
+    // slow rise after releasing the line (weak pull-up, long cable) must not be
+    // taken for the sensor response, however fast the state machine runs
+    static const uint32_t rise_clock_frequencies[] = { 1000000, 10000000 };
+    static const uint32_t rise_times_ns[] = { 500, 2000 };
+    for (unsigned p = 0; p < 3; p++) {
+        bool capture_pulses = (programs[p] == &r->pulses_program);
+        for (unsigned k = 0; k < 4; k++) {
+            unsigned f = k % 2; // every rise time at every clock rate
+            sensor_init(&sensor, DHT22, frame);
+            sensor.rise_ns = rise_times_ns[k / 2];
+            replay_at(programs[p], capture_pulses, DHT22, &sensor, &sim, rise_clock_frequencies[f]);
+            CHECK(sim.rx_count == (capture_pulses ? DHT_PULSE_COUNT : 5u), "%u ns rise, program %u at %u Hz: received %u words", sensor.rise_ns, p, rise_clock_frequencies[f], sim.rx_count);
+            uint8_t received[5];
+            if (capture_pulses) {
+                uint32_t widths[DHT_PULSE_COUNT];
+                uint32_t clocks_per_us = rise_clock_frequencies[f] / 1000000;
+                int clocks_per_loop = pio_sim_get_define(programs[p], "pulse_measurement_clocks_per_loop");
+                for (unsigned b = 0; b < DHT_PULSE_COUNT; b++) {
+                    widths[b] = sim.rx[b] * clocks_per_loop / clocks_per_us;
+                }
+                dht_decode_pulses(widths, received);
+            } else {
+                for (unsigned b = 0; b < 5; b++) {
+                    received[b] = sim.rx[b] & 0xFF;
+                }
+            }
+            CHECK(memcmp(received, frame, 5) == 0, "%u ns rise, program %u at %u Hz: frame mismatch", sensor.rise_ns, p, rise_clock_frequencies[f]);
+        }
+    }
+
+    // faster state machine clocks keep the same timing, with finer pulse widths
+    static const uint32_t clock_frequencies[] = { 4000000, 10000000 };
+    int clocks_per_loop = pio_sim_get_define(&r->pulses_program, "pulse_measurement_clocks_per_loop");
+    for (unsigned f = 0; f < sizeof(clock_frequencies) / sizeof(clock_frequencies[0]); f++) {
+        uint32_t clocks_per_us = clock_frequencies[f] / 1000000;
+        for (int model = DHT11; model <= DHT22; model++) {
+            make_frame(0x55, 0xAA, 0x0F, 0xF0, frame);
+            sensor_init(&sensor, model, frame);
+            replay_at(&r->bits_program, false, model, &sensor, &sim, clock_frequencies[f]);
+            uint8_t received[5];
+            for (unsigned b = 0; b < 5; b++) {
+                received[b] = sim.rx[b] & 0xFF;
+            }
+            CHECK(sim.rx_count == 5 && memcmp(received, frame, 5) == 0, "%s replay at %u Hz: frame mismatch", model_names[model], clock_frequencies[f]);
+
+            sensor_init(&sensor, model, frame);
+            replay_at(&r->compact_program, false, model, &sensor, &sim, clock_frequencies[f]);
+            for (unsigned b = 0; b < 5; b++) {
+                received[b] = sim.rx[b] & 0xFF;
+            }
+            CHECK(sim.rx_count == 5 && memcmp(received, frame, 5) == 0, "%s compact replay at %u Hz: frame mismatch", model_names[model], clock_frequencies[f]);
+
+            sensor_init(&sensor, model, frame);
+            replay_at(&r->pulses_program, true, model, &sensor, &sim, clock_frequencies[f]);
+            CHECK(sim.rx_count == DHT_PULSE_COUNT, "%s pulse replay at %u Hz: received %u widths", model_names[model], clock_frequencies[f], sim.rx_count);
+            for (unsigned b = 0; b < DHT_PULSE_COUNT && b < sim.rx_count; b++) {
+                // in state machine clocks, converted to microseconds only for the check
+                uint32_t width_clocks = sim.rx[b] * clocks_per_loop;
+                bool bit = frame[b / 8] & (0x80 >> (b % 8));
+                int32_t error = (int32_t)width_clocks - (int32_t)((bit ? sensor.long_us : sensor.short_us) * clocks_per_us);
+                CHECK(error >= -(int32_t)clocks_per_us && error <= (int32_t)clocks_per_us,
+                        "%s pulse replay at %u Hz: bit %u width %u clocks", model_names[model], clock_frequencies[f], b, width_clocks);
+            }
+        }
+    }
+}
+
+//
+// benchmarks
+//
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(void) {
+    const unsigned case_count = sizeof(frame_cases) / sizeof(frame_cases[0]);
+    const unsigned iterations = 1u << 22;
+    volatile int32_t sink = 0;
+
+    double start = now_ns();
+    for (unsigned i = 0; i < iterations; i++) {
+        const frame_case_t *c = &frame_cases[i % case_count];
+        int16_t h, t;
+        if (dht_decode_frame_x10(c->model, c->frame, &h, &t) == DHT_RESULT_OK) {
+            sink += h + t;
+        }
+    }
+    printf("dht_decode_frame_x10: %.2f ns/frame\n", (now_ns() - start) / iterations);
+
+    enum { BATCH = 1024 };
+    static dht_frame_t frames[BATCH];
+    static dht_values_x10_t values[BATCH];
+    uint32_t invalid_mask[DHT_BATCH_MASK_WORDS(BATCH)];
+    make_random_frames(frames, BATCH, 1);
+    start = now_ns();
+    for (unsigned i = 0; i < iterations / BATCH; i++) {
+        sink += dht_decode_batch((dht_model_t)(i % 4), frames, BATCH, values, invalid_mask);
+        sink += values[i % BATCH].temperature_c_x10;
+    }
+    printf("dht_decode_batch: %.2f ns/frame\n", (now_ns() - start) / (iterations / BATCH * BATCH));
+
+    uint32_t widths[DHT_PULSE_COUNT];
+    uint8_t frame[5];
+    make_pulses(frame_cases[0].frame, 24, 74, 3, widths);
+    start = now_ns();
+    for (unsigned i = 0; i < iterations / 16; i++) {
+        widths[i % DHT_PULSE_COUNT] ^= 1;
+        sink += dht_decode_pulses(widths, frame);
+    }
+    printf("dht_decode_pulses: %.2f ns/frame\n", (now_ns() - start) / (iterations / 16));
+    (void)sink;
+}
+
+int main(int argc, char **argv) {
+    const char *pio_path = (argc > 1) ? argv[1] : DHT_PIO_PATH;
+    bool run_bench = (argc > 2 && strcmp(argv[2], "--bench") == 0);
+
+    static replay_t r;
+    if (!pio_sim_load(&r.bits_program, pio_path, "dht") || !pio_sim_load(&r.pulses_program, pio_path, "dht_pulses")
+            || !pio_sim_load(&r.compact_program, pio_path, "dht_compact")) {
+        printf("FAIL: cannot load programs from %s\n", pio_path);
+        return 1;
+    }
+
+    test_decode_frames();
+    test_decode_batch();
+    test_frame_plausibility();
+    test_decode_pulses();
+    test_filter();
+    test_pio_replay(&r);
+    if (run_bench) {
+        bench();
+    }
+
+    if (failure_count != 0) {
+        printf("%u checks failed\n", failure_count);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// Compiles dht.hpp on the host. The wrappers are instantiated for both model
+// families, and their constexpr decoders are checked against frames recorded
+// in dht_host_test.c.
+
+#include <dht.hpp>
+
+template class dht::Sensor<DHT11>;
+template class dht::Sensor<DHT22>;
+
+namespace {
+
+constexpr uint8_t dht11_frame[5] = { 0x25, 0x00, 0x18, 0x03, 0x40 };
+constexpr uint8_t dht11_below_zero_frame[5] = { 0x14, 0x00, 0x01, 0x85, 0x9A };
+constexpr uint8_t dht22_frame[5] = { 0x02, 0x8C, 0x01, 0x5F, 0xEE };
+constexpr uint8_t dht22_negative_frame[5] = { 0x01, 0xF4, 0x80, 0x65, 0xDA };
+
+constexpr dht::Reading dht11 = dht::Sensor<DHT11>::decode(dht11_frame);
+constexpr dht::Reading dht11_below_zero = dht::Sensor<DHT11>::decode(dht11_below_zero_frame);
+constexpr dht::Reading dht22 = dht::Sensor<DHT22>::decode(dht22_frame);
+constexpr dht::Reading dht22_negative = dht::Sensor<DHT22>::decode(dht22_negative_frame);
+
+static_assert(dht11.ok() && dht11.humidity_x10 == 370 && dht11.temperature_c_x10 == 243, "DHT11 decode");
+static_assert(dht11_below_zero.humidity_x10 == 200 && dht11_below_zero.temperature_c_x10 == 0, "DHT11 below-zero decode");
+static_assert(dht22.ok() && dht22.humidity_x10 == 652 && dht22.temperature_c_x10 == 351, "DHT22 decode");
+static_assert(dht22_negative.humidity_x10 == 500 && dht22_negative.temperature_c_x10 == -101, "DHT22 negative decode");
+
+static_assert(dht::Sensor<DHT11>::Traits::start_pulse_duration_us == 18000, "DHT11 start signal");
+static_assert(dht::Sensor<DHT22>::Traits::min_interval_us == 2000000, "DHT22 minimum interval");
+
+} // namespace
@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "pio_sim.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// operand names, shared by all instructions
+enum {
+    REG_PINS,
+    REG_X,
+    REG_Y,
+    REG_NULL,
+    REG_PINDIRS,
+    REG_PC,
+    REG_ISR,
+    REG_OSR,
+    REG_STATUS,
+    REG_GPIO,
+    REG_PIN,
+    REG_INVALID,
+};
+
+enum {
+    COND_ALWAYS,
+    COND_NOT_X,
+    COND_X_DEC,
+    COND_NOT_Y,
+    COND_Y_DEC,
+    COND_X_NE_Y,
+    COND_PIN,
+    COND_NOT_OSRE,
+};
+
+#define MAX_TOKENS 8
+
+//
+// assembler
+//
+
+static int find_symbol(const pio_sim_symbol_t *symbols, unsigned count, const char *name) {
+    for (unsigned i = 0; i < count; i++) {
+        if (strcmp(symbols[i].name, name) == 0) {
+            return symbols[i].value;
+        }
+    }
+    return -1;
+}
+
+static bool add_symbol(pio_sim_symbol_t *symbols, unsigned *count, const char *name, int value) {
+    if (*count == PIO_SIM_MAX_SYMBOLS || strlen(name) >= PIO_SIM_MAX_NAME) {
+        return false;
+    }
+    strcpy(symbols[*count].name, name);
+    symbols[*count].value = value;
+    (*count)++;
+    return true;
+}
+
+static int parse_register(const char *token) {
+    static const char *const names[] = { "pins", "x", "y", "null", "pindirs", "pc", "isr", "osr", "status", "gpio", "pin" };
+    for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(token, names[i]) == 0) {
+            return i;
+        }
+    }
+    return REG_INVALID;
+}
+
+static bool parse_value(const pio_sim_program_t *program, const char *token, uint32_t *value) {
+    char *end;
+    unsigned long v = strtoul(token, &end, 0);
+    if (*token != '\0' && *end == '\0') {
+        *value = v;
+        return true;
+    }
+    int define = find_symbol(program->defines, program->define_count, token);
+    if (define < 0) {
+        return false;
+    }
+    *value = define;
+    return true;
+}
+
+static unsigned tokenize(char *line, char *tokens[MAX_TOKENS]) {
+    unsigned count = 0;
+    for (char *p = line; *p != '\0';) {
+        while (isspace((unsigned char)*p) || *p == ',') {
+            p++;
+        }
+        if (*p == '\0' || count == MAX_TOKENS) {
+            break;
+        }
+        tokens[count++] = p;
+        while (*p != '\0' && !isspace((unsigned char)*p) && *p != ',') {
+            p++;
+        }
+        if (*p != '\0') {
+            *p++ = '\0';
+        }
+    }
+    return count;
+}
+
+static bool parse_instruction(pio_sim_program_t *program, char *tokens[], unsigned count, char jmp_target[PIO_SIM_MAX_NAME]) {
+    pio_sim_instr_t *instr = &program->instructions[program->length];
+    memset(instr, 0, sizeof(pio_sim_instr_t));
+    instr->block = true;
+
+    // trailing delay
+    if (count > 1 && tokens[count - 1][0] == '[') {
+        uint32_t delay;
+        char *token = tokens[count - 1] + 1;
+        token[strcspn(token, "]")] = '\0';
+        if (!parse_value(program, token, &delay) || delay > 31) {
+            return false;
+        }
+        instr->delay = delay;
+        count--;
+    }
+    const char *mnemonic = tokens[0];
+    uint32_t value;
+    if (strcmp(mnemonic, "jmp") == 0) {
+        static const char *const conds[] = { "", "!x", "x--", "!y", "y--", "x!=y", "pin", "!osre" };
+        instr->op = PIO_SIM_JMP;
+        if (count == 3) {
+            instr->cond = 0xff;
+            for (unsigned i = 1; i < sizeof(conds) / sizeof(conds[0]); i++) {
+                if (strcmp(tokens[1], conds[i]) == 0) {
+                    instr->cond = i;
+                }
+            }
+            if (instr->cond == 0xff) {
+                return false;
+            }
+        } else if (count != 2) {
+            return false;
+        }
+        strcpy(jmp_target, tokens[count - 1]);
+    } else if (strcmp(mnemonic, "wait") == 0) {
+        instr->op = PIO_SIM_WAIT;
+        if (count != 4 || !parse_value(program, tokens[1], &value) || value > 1) {
+            return false;
+        }
+        instr->cond = value;
+        instr->src = parse_register(tokens[2]);
+        if ((instr->src != REG_GPIO && instr->src != REG_PIN) || !parse_value(program, tokens[3], &instr->operand)) {
+            return false;
+        }
+    } else if (strcmp(mnemonic, "in") == 0 || strcmp(mnemonic, "out") == 0) {
+        instr->op = (mnemonic[0] == 'i') ? PIO_SIM_IN : PIO_SIM_OUT;
+        if (count != 3 || !parse_value(program, tokens[2], &value) || value < 1 || value > 32) {
+            return false;
+        }
+        instr->bit_count = value;
+        uint8_t reg = parse_register(tokens[1]);
+        if (reg == REG_INVALID) {
+            return false;
+        }
+        if (instr->op == PIO_SIM_IN) {
+            instr->src = reg;
+        } else {
+            instr->dst = reg;
+        }
+    } else if (strcmp(mnemonic, "push") == 0 || strcmp(mnemonic, "pull") == 0) {
+        instr->op = (mnemonic[1] == 'u' && mnemonic[2] == 's') ? PIO_SIM_PUSH : PIO_SIM_PULL;
+        for (unsigned i = 1; i < count; i++) {
+            if (strcmp(tokens[i], "iffull") == 0 || strcmp(tokens[i], "ifempty") == 0) {
+                instr->if_flag = true;
+            } else if (strcmp(tokens[i], "noblock") == 0) {
+                instr->block = false;
+            } else if (strcmp(tokens[i], "block") != 0) {
+                return false;
+            }
+        }
+    } else if (strcmp(mnemonic, "mov") == 0 || strcmp(mnemonic, "nop") == 0) {
+        instr->op = PIO_SIM_MOV;
+        if (mnemonic[0] == 'n') {
+            instr->dst = instr->src = REG_Y;
+            return count == 1;
+        }
+        if (count != 3) {
+            return false;
+        }
+        const char *src = tokens[2];
+        if (src[0] == '~' || src[0] == '!') {
+            instr->mov_op = 1;
+            src++;
+        } else if (src[0] == ':' && src[1] == ':') {
+            instr->mov_op = 2;
+            src += 2;
+        }
+        instr->dst = parse_register(tokens[1]);
+        instr->src = parse_register(src);
+        if (instr->dst == REG_INVALID || instr->src == REG_INVALID) {
+            return false;
+        }
+    } else if (strcmp(mnemonic, "set") == 0) {
+        instr->op = PIO_SIM_SET;
+        if (count != 3 || !parse_value(program, tokens[2], &instr->operand) || instr->operand > 31) {
+            return false;
+        }
+        instr->dst = parse_register(tokens[1]);
+        if (instr->dst != REG_PINS && instr->dst != REG_X && instr->dst != REG_Y && instr->dst != REG_PINDIRS) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool pio_sim_load(pio_sim_program_t *program, const char *path, const char *name) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return false;
+    }
+    memset(program, 0, sizeof(pio_sim_program_t));
+    bool found = false, ok = true, wrap_set = false;
+    char jmp_targets[PIO_SIM_MAX_INSTRUCTIONS][PIO_SIM_MAX_NAME] = { { 0 } };
+    char line[256];
+    while (ok && fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, ";")] = '\0';
+        char *comment = strstr(line, "//");
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char *tokens[MAX_TOKENS];
+        unsigned count = tokenize(line, tokens);
+        if (count == 0) {
+            continue;
+        }
+        if (strcmp(tokens[0], ".program") == 0) {
+            if (found) {
+                break;
+            }
+            found = (count == 2 && strcmp(tokens[1], name) == 0);
+            continue;
+        }
+        if (!found) {
+            continue;
+        }
+        if (tokens[0][0] == '.') {
+            if (strcmp(tokens[0], ".define") == 0) {
+                unsigned i = (count > 1 && strcmp(tokens[1], "public") == 0) ? 2 : 1;
+                uint32_t value;
+                ok = (count == i + 2) && parse_value(program, tokens[i + 1], &value)
+                        && add_symbol(program->defines, &program->define_count, tokens[i], value);
+            } else if (strcmp(tokens[0], ".wrap_target") == 0) {
+                program->wrap_target = program->length;
+            } else if (strcmp(tokens[0], ".wrap") == 0) {
+                program->wrap = program->length - 1;
+                wrap_set = true;
+            } else if (strcmp(tokens[0], ".side_set") == 0) {
+                ok = false;
+            }
+            continue;
+        }
+        unsigned first = (strcmp(tokens[0], "public") == 0) ? 1 : 0;
+        size_t len = (count > first) ? strlen(tokens[first]) : 0;
+        if (len > 1 && tokens[first][len - 1] == ':') {
+            tokens[first][len - 1] = '\0';
+            ok = add_symbol(program->labels, &program->label_count, tokens[first], program->length);
+            continue;
+        }
+        ok = program->length < PIO_SIM_MAX_INSTRUCTIONS
+                && parse_instruction(program, tokens, count, jmp_targets[program->length]);
+        program->length++;
+    }
+    fclose(file);
+    if (!ok || !found || program->length == 0) {
+        return false;
+    }
+    if (!wrap_set) {
+        program->wrap = program->length - 1;
+    }
+    for (unsigned i = 0; i < program->length; i++) {
+        if (program->instructions[i].op == PIO_SIM_JMP) {
+            int target = find_symbol(program->labels, program->label_count, jmp_targets[i]);
+            if (target < 0 && !parse_value(program, jmp_targets[i], (uint32_t *)&target)) {
+                return false;
+            }
+            program->instructions[i].operand = target;
+        }
+    }
+    return true;
+}
+
+int pio_sim_get_define(const pio_sim_program_t *program, const char *name) {
+    return find_symbol(program->defines, program->define_count, name);
+}
+
+int pio_sim_get_label(const pio_sim_program_t *program, const char *name) {
+    return find_symbol(program->labels, program->label_count, name);
+}
+
+//
+// execution
+//
+
+void pio_sim_init(pio_sim_t *sim, const pio_sim_program_t *program) {
+    memset(sim, 0, sizeof(pio_sim_t));
+    sim->program = program;
+    sim->push_threshold = 32;
+    sim->pull_threshold = 32;
+}
+
+static uint32_t reverse_bits(uint32_t v) {
+    uint32_t r = 0;
+    for (unsigned i = 0; i < 32; i++) {
+        r = (r << 1) | ((v >> i) & 1);
+    }
+    return r;
+}
+
+static uint32_t read_source(const pio_sim_t *sim, uint8_t src, uint32_t pins_in) {
+    switch (src) {
+    case REG_PINS:
+        return pins_in;
+    case REG_X:
+        return sim->x;
+    case REG_Y:
+        return sim->y;
+    case REG_ISR:
+        return sim->isr;
+    case REG_OSR:
+        return sim->osr;
+    default:
+        return 0; // null, status
+    }
+}
+
+static bool push(pio_sim_t *sim) {
+    if (sim->rx_count == PIO_SIM_RX_CAPACITY) {
+        return false; // FIFO drained by the test, a full buffer means a runaway program
+    }
+    sim->rx[sim->rx_count++] = sim->isr;
+    sim->isr = 0;
+    sim->isr_count = 0;
+    return true;
+}
+
+static bool pull(pio_sim_t *sim) {
+    if (sim->tx_count == 0) {
+        return false;
+    }
+    sim->osr = sim->tx[0];
+    memmove(sim->tx, sim->tx + 1, --sim->tx_count * sizeof(uint32_t));
+    sim->osr_count = 0;
+    return true;
+}
+
+// returns false if the instruction stalls
+static bool execute(pio_sim_t *sim, const pio_sim_instr_t *instr, uint32_t pins_in, unsigned *next_pc) {
+    switch (instr->op) {
+    case PIO_SIM_JMP: {
+        bool taken;
+        switch (instr->cond) {
+        case COND_NOT_X: taken = (sim->x == 0); break;
+        case COND_X_DEC: taken = (sim->x-- != 0); break;
+        case COND_NOT_Y: taken = (sim->y == 0); break;
+        case COND_Y_DEC: taken = (sim->y-- != 0); break;
+        case COND_X_NE_Y: taken = (sim->x != sim->y); break;
+        case COND_PIN: taken = (pins_in & 1) != 0; break;
+        case COND_NOT_OSRE: taken = (sim->osr_count < sim->pull_threshold); break;
+        default: taken = true; break;
+        }
+        if (taken) {
+            *next_pc = instr->operand;
+        }
+        return true;
+    }
+    case PIO_SIM_WAIT:
+        return ((pins_in >> instr->operand) & 1) == instr->cond;
+    case PIO_SIM_IN: {
+        unsigned n = instr->bit_count;
+        uint32_t data = read_source(sim, instr->src, pins_in);
+        uint32_t mask = (n == 32) ? ~0u : ((1u << n) - 1);
+        if (sim->in_shift_right) {
+            sim->isr = (n == 32) ? data : (sim->isr >> n) | ((data & mask) << (32 - n));
+        } else {
+            sim->isr = (n == 32) ? data : (sim->isr << n) | (data & mask);
+        }
+        sim->isr_count = (sim->isr_count + n > 32) ? 32 : sim->isr_count + n;
+        if (sim->autopush && sim->isr_count >= sim->push_threshold) {
+            return push(sim);
+        }
+        return true;
+    }
+    case PIO_SIM_OUT: {
+        if (sim->autopull && sim->osr_count >= sim->pull_threshold && !pull(sim)) {
+            return false;
+        }
+        unsigned n = instr->bit_count;
+        uint32_t data;
+        if (sim->out_shift_right) {
+            data = (n == 32) ? sim->osr : sim->osr & ((1u << n) - 1);
+            sim->osr = (n == 32) ? 0 : sim->osr >> n;
+        } else {
+            data = (n == 32) ? sim->osr : sim->osr >> (32 - n);
+            sim->osr = (n == 32) ? 0 : sim->osr << n;
+        }
+        sim->osr_count = (sim->osr_count + n > 32) ? 32 : sim->osr_count + n;
+        switch (instr->dst) {
+        case REG_PINS: sim->pins = data; break;
+        case REG_X: sim->x = data; break;
+        case REG_Y: sim->y = data; break;
+        case REG_PINDIRS: sim->pindirs = data; break;
+        case REG_PC: *next_pc = data; break;
+        case REG_ISR: sim->isr = data; sim->isr_count = n; break;
+        default: break;
+        }
+        return true;
+    }
+    case PIO_SIM_PUSH:
+        if (instr->if_flag && sim->isr_count < sim->push_threshold) {
+            return true;
+        }
+        return push(sim) || !instr->block;
+    case PIO_SIM_PULL:
+        if (instr->if_flag && sim->osr_count < sim->pull_threshold) {
+            return true;
+        }
+        if (!pull(sim)) {
+            if (instr->block) {
+                return false;
+            }
+            sim->osr = sim->x;
+        }
+        return true;
+    case PIO_SIM_MOV: {
+        uint32_t data = read_source(sim, instr->src, pins_in);
+        if (instr->mov_op == 1) {
+            data = ~data;
+        } else if (instr->mov_op == 2) {
+            data = reverse_bits(data);
+        }
+        switch (instr->dst) {
+        case REG_PINS: sim->pins = data; break;
+        case REG_X: sim->x = data; break;
+        case REG_Y: sim->y = data; break;
+        case REG_PC: *next_pc = data; break;
+        case REG_ISR: sim->isr = data; sim->isr_count = 0; break;
+        case REG_OSR: sim->osr = data; sim->osr_count = 0; break;
+        default: break;
+        }
+        return true;
+    }
+    case PIO_SIM_SET:
+        switch (instr->dst) {
+        case REG_PINS: sim->pins = (sim->pins & ~1u) | (instr->operand & 1); break;
+        case REG_X: sim->x = instr->operand; break;
+        case REG_Y: sim->y = instr->operand; break;
+        case REG_PINDIRS: sim->pindirs = (sim->pindirs & ~1u) | (instr->operand & 1); break;
+        default: break;
+        }
+        return true;
+    }
+    return true;
+}
+
+void pio_sim_step(pio_sim_t *sim, uint32_t pins_in) {
+    sim->cycle++;
+    if (sim->delay_left > 0) {
+        sim->delay_left--;
+        return;
+    }
+    const pio_sim_program_t *program = sim->program;
+    const pio_sim_instr_t *instr = &program->instructions[sim->pc];
+    unsigned next_pc = (sim->pc == program->wrap) ? program->wrap_target : sim->pc + 1;
+    if (execute(sim, instr, pins_in, &next_pc)) {
+        sim->pc = next_pc;
+        sim->delay_left = instr->delay;
+    }
+}
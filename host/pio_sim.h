@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef _PIO_SIM_H_
+#define _PIO_SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** \file pio_sim.h
+ *
+ * \brief Cycle-accurate host model of a single PIO state machine.
+ *
+ * Programs are loaded straight from .pio sources, so the replay always runs
+ * the code that gets deployed. Only the subset of pioasm used by this library
+ * is supported: no side-set, and a single IN/SET/OUT pin base of 0.
+ */
+
+#define PIO_SIM_MAX_INSTRUCTIONS 32
+#define PIO_SIM_MAX_SYMBOLS 16
+#define PIO_SIM_MAX_NAME 48
+#define PIO_SIM_RX_CAPACITY 64
+#define PIO_SIM_TX_CAPACITY 4
+
+typedef enum pio_sim_op_t {
+    PIO_SIM_JMP,
+    PIO_SIM_WAIT,
+    PIO_SIM_IN,
+    PIO_SIM_OUT,
+    PIO_SIM_PUSH,
+    PIO_SIM_PULL,
+    PIO_SIM_MOV,
+    PIO_SIM_SET,
+} pio_sim_op_t;
+
+typedef struct pio_sim_instr_t {
+    pio_sim_op_t op;
+    uint8_t cond; // jmp condition, or wait polarity
+    uint8_t dst;
+    uint8_t src;
+    uint8_t mov_op; // 0 none, 1 invert, 2 bit-reverse
+    uint8_t bit_count;
+    bool block;
+    bool if_flag; // iffull / ifempty
+    uint32_t operand; // jmp target, set value, wait index
+    uint8_t delay;
+} pio_sim_instr_t;
+
+typedef struct pio_sim_symbol_t {
+    char name[PIO_SIM_MAX_NAME];
+    int value;
+} pio_sim_symbol_t;
+
+typedef struct pio_sim_program_t {
+    pio_sim_instr_t instructions[PIO_SIM_MAX_INSTRUCTIONS];
+    unsigned length;
+    unsigned wrap_target;
+    unsigned wrap;
+    pio_sim_symbol_t labels[PIO_SIM_MAX_SYMBOLS];
+    unsigned label_count;
+    pio_sim_symbol_t defines[PIO_SIM_MAX_SYMBOLS];
+    unsigned define_count;
+} pio_sim_program_t;
+
+typedef struct pio_sim_t {
+    const pio_sim_program_t *program;
+    unsigned pc;
+    uint32_t x, y;
+    uint32_t isr, osr;
+    unsigned isr_count, osr_count;
+    uint32_t pins, pindirs;
+    // shift configuration, as set by sm_config_set_in_shift/out_shift
+    bool in_shift_right, autopush;
+    unsigned push_threshold;
+    bool out_shift_right, autopull;
+    unsigned pull_threshold;
+    unsigned delay_left;
+    uint64_t cycle;
+    uint32_t rx[PIO_SIM_RX_CAPACITY];
+    unsigned rx_count;
+    uint32_t tx[PIO_SIM_TX_CAPACITY];
+    unsigned tx_count;
+} pio_sim_t;
+
+/**
+ * \brief Assemble one program from a .pio source file.
+ *
+ * \return False if the file or program can't be read, or uses unsupported syntax.
+ */
+bool pio_sim_load(pio_sim_program_t *program, const char *path, const char *name);
+
+/** \brief Value of a `.define`, or -1 if missing. */
+int pio_sim_get_define(const pio_sim_program_t *program, const char *name);
+
+/** \brief Offset of a label, or -1 if missing. */
+int pio_sim_get_label(const pio_sim_program_t *program, const char *name);
+
+/** \brief Reset state machine, with input shifting left and no autopush/autopull. */
+void pio_sim_init(pio_sim_t *sim, const pio_sim_program_t *program);
+
+/**
+ * \brief Run one clock cycle.
+ *
+ * \param sim State machine.
+ * \param pins_in Input pin levels, bit 0 is the IN/JMP pin.
+ */
+void pio_sim_step(pio_sim_t *sim, uint32_t pins_in);
+
+#endif // _PIO_SIM_H_
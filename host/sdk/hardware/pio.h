@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// Just enough of the Pico SDK for the public headers to compile on the host,
+// for their types and defaults. No driver code is built against it.
+
+#ifndef _HOST_HARDWARE_PIO_H_
+#define _HOST_HARDWARE_PIO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+typedef struct pio_hw pio_hw_t;
+typedef pio_hw_t *PIO;
+
+static inline void tight_loop_contents(void) {}
+
+#endif // _HOST_HARDWARE_PIO_H_
@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2021 Valentin Milea <valentin.milea@gmail.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+// Just enough of the Pico SDK for the public headers to compile on the host.
+
+#ifndef _HOST_PICO_TIME_H_
+#define _HOST_PICO_TIME_H_
+
+#include <stdint.h>
+
+typedef int32_t alarm_id_t;
+
+#endif // _HOST_PICO_TIME_H_